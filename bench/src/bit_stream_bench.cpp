@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+#include "common/bit_stream.h"
+#include "common/input_packet.h"
+
+// encode and decode throughput of the bit stream and of input packets.
+// raw fields of mixed widths, then packets of held keys (a few long runs)
+// and of noisy input (a run per tick), over several window lengths.
+
+typedef std::chrono::steady_clock Clock;
+
+static const uint32_t kNumFields = 1 << 20;
+static const uint32_t kNumPackets = 1 << 18;
+static const uint32_t kWindowLengths[] = { 8, 32, 64 };
+
+static double get_seconds(const Clock::time_point& start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static void bench_fields() {
+  std::vector<uint32_t> widths(kNumFields);
+  std::vector<uint32_t> values(kNumFields);
+  uint32_t seed = 12345;
+  for(uint32_t i = 0; i < kNumFields; ++i) {
+    seed = seed * 1664525u + 1013904223u;
+    widths[i] = 1 + (seed >> 24) % 32;
+    values[i] = widths[i] == 32 ? seed : seed & ((1u << widths[i]) - 1);
+  }
+  
+  BitWriter writer;
+  for(uint32_t i = 0; i < kNumFields; ++i) {
+    writer.Write(values[i], widths[i]);
+  }
+  writer.Clear();
+  Clock::time_point start = Clock::now();
+  for(uint32_t i = 0; i < kNumFields; ++i) {
+    writer.Write(values[i], widths[i]);
+  }
+  writer.Flush();
+  const double write_s = get_seconds(start);
+  
+  BitReader reader(writer.GetData().data(), writer.GetData().size());
+  uint32_t sum = 0;
+  start = Clock::now();
+  for(uint32_t i = 0; i < kNumFields; ++i) {
+    uint32_t value = 0;
+    reader.Read(value, widths[i]);
+    sum += value;
+  }
+  const double read_s = get_seconds(start);
+  
+  uint32_t expected = 0;
+  for(uint32_t value : values) {
+    expected += value;
+  }
+  const double mb = writer.GetData().size() / 1e6;
+  printf("fields, 1-32 bits: write %.2f ns/field %.0f MB/s, read %.2f ns/field %.0f MB/s%s\n",
+         write_s * 1e9 / kNumFields, mb / write_s, read_s * 1e9 / kNumFields, mb / read_s,
+         sum == expected ? "" : "  MISMATCH");
+}
+
+// packets of a window sliding over 'inputs', one per tick.
+static bool bench_packets(const char* name, const std::vector<Input>& inputs, uint32_t length) {
+  InputWindow window(length);
+  std::vector<InputPacket> packets(kNumPackets);
+  for(uint32_t t = 0; t < kNumPackets; ++t) {
+    window.Push(t, inputs[t]);
+    window.GetPacket(packets[t]);
+  }
+  
+  BitWriter writer;
+  std::vector<uint32_t> offsets(kNumPackets);
+  Clock::time_point start = Clock::now();
+  for(uint32_t t = 0; t < kNumPackets; ++t) {
+    offsets[t] = (uint32_t)writer.GetData().size();
+    write_input_packet(packets[t], writer);
+    writer.Flush();
+  }
+  const double write_s = get_seconds(start);
+  const std::vector<uint8_t>& data = writer.GetData();
+  
+  bool same = true;
+  InputPacket packet;
+  start = Clock::now();
+  for(uint32_t t = 0; t < kNumPackets; ++t) {
+    const uint32_t end = t + 1 < kNumPackets ? offsets[t + 1] : (uint32_t)data.size();
+    BitReader reader(data.data() + offsets[t], end - offsets[t]);
+    same = read_input_packet(reader, packet) && same;
+    // the oldest input is decoded last.
+    const uint32_t oldest = packets[t].m_count - 1;
+    same = same && packet.m_newest_tick == packets[t].m_newest_tick && packet.m_count == packets[t].m_count
+      && packet.m_inputs[oldest] == packets[t].m_inputs[oldest];
+  }
+  const double read_s = get_seconds(start);
+  
+  printf("%6s %7u %10.1f %10.1f %10.1f%s\n", name, length, (double)data.size() / kNumPackets,
+         write_s * 1e9 / kNumPackets, read_s * 1e9 / kNumPackets, same ? "" : "  MISMATCH");
+  return same;
+}
+
+int main(int argc, const char* argv[]) {
+  (void)argc;
+  (void)argv;
+  bench_fields();
+  
+  // held keys change every 20 ticks, noisy input every tick.
+  std::vector<Input> held(kNumPackets);
+  std::vector<Input> noisy(kNumPackets);
+  uint32_t seed = 54321;
+  for(uint32_t t = 0; t < kNumPackets; ++t) {
+    seed = seed * 1664525u + 1013904223u;
+    held[t] = Input(2u << (t / 20 % 4));
+    const uint32_t buttons = (seed >> 16) % 16 << 1;
+    noisy[t] = t > 0 && Input(buttons) == noisy[t - 1] ? Input(buttons ^ 2) : Input(buttons);
+  }
+  
+  printf("%6s %7s %10s %10s %10s\n", "input", "window", "bytes/pkt", "write ns", "read ns");
+  bool same = true;
+  for(uint32_t length : kWindowLengths) {
+    same = bench_packets("held", held, length) && same;
+    same = bench_packets("noisy", noisy, length) && same;
+  }
+  return same ? 0 : 1;
+}
@@ -0,0 +1,159 @@
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "common/bvh.h"
+#include "test_util.h"
+
+// ray and region queries of the bvh against a brute-force scan over every
+// cube of the world, over several entity counts at the same density. both
+// have to find the same hits.
+
+typedef std::chrono::steady_clock Clock;
+
+static const uint32_t kCounts[] = { 1000, 10000, 100000 };
+static const uint32_t kNumRays = 2048;
+static const uint32_t kNumRegions = 2048;
+// world units per entity along each side of the square they are spread over.
+static const float kSpacing = 4.f;
+
+static double get_seconds(const Clock::time_point& start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static void build_world(World& world, uint32_t count, float size) {
+  for(uint32_t i = 0; i < count; ++i) {
+    Cube cube;
+    cube.m_translation = vec3(random_float(0.f, size), random_float(0.f, 2.f), random_float(0.f, size));
+    cube.m_rotation = random_float(0.f, 6.28f);
+    cube.m_scale = random_float(0.5f, 1.5f);
+    world.Spawn(cube, false);
+  }
+}
+
+// nearest hit, ties go to the lower id like Bvh::Raycast.
+static bool raycast_brute(const World& world, const Ray& ray, RayHit& hit) {
+  bool found = false;
+  float best = ray.m_max_distance;
+  for(uint32_t i = 0; i < world.GetNumEntities(); ++i) {
+    float distance;
+    if(!intersect_ray(get_cube_box(world, i), ray.m_origin, ray.m_direction, best, distance)) {
+      continue;
+    }
+    const entity_t entity = world.GetEntity(i);
+    if(!found || distance < best || (distance == best && entity < hit.m_entity)) {
+      hit.m_entity = entity;
+      hit.m_distance = distance;
+      best = distance;
+      found = true;
+    }
+  }
+  return found;
+}
+
+static void query_brute(const World& world, const Aabb* regions, uint32_t count, std::vector<RegionBatchHit>& hits) {
+  hits.clear();
+  for(uint32_t r = 0; r < count; ++r) {
+    for(uint32_t i = 0; i < world.GetNumEntities(); ++i) {
+      if(overlap_region(regions[r], get_cube_box(world, i))) {
+        const RegionBatchHit hit = { r, world.GetEntity(i) };
+        hits.push_back(hit);
+      }
+    }
+  }
+}
+
+static bool less_hit(const RegionBatchHit& a, const RegionBatchHit& b) {
+  return a.m_region != b.m_region ? a.m_region < b.m_region : a.m_entity < b.m_entity;
+}
+
+static bool same_region_hits(std::vector<RegionBatchHit>& a, std::vector<RegionBatchHit>& b) {
+  if(a.size() != b.size()) {
+    return false;
+  }
+  std::sort(a.begin(), a.end(), less_hit);
+  std::sort(b.begin(), b.end(), less_hit);
+  for(size_t i = 0; i < a.size(); ++i) {
+    if(a[i].m_region != b[i].m_region || a[i].m_entity != b[i].m_entity) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, const char* argv[]) {
+  (void)argc;
+  (void)argv;
+  printf("%10s %10s %12s %12s %9s %12s %12s %9s\n", "entities", "build ms", "bvh ns/ray", "scan ns/ray", "speedup",
+         "bvh ns/box", "scan ns/box", "speedup");
+  
+  bool same = true;
+  for(uint32_t count : kCounts) {
+    const float size = kSpacing * sqrtf((float)count);
+    World world;
+    build_world(world, count, size);
+    
+    std::vector<Ray> rays(kNumRays);
+    for(Ray& ray : rays) {
+      const float angle = random_float(0.f, 6.28f);
+      ray.m_origin = vec3(random_float(0.f, size), 1.f, random_float(0.f, size));
+      ray.m_direction = vec3(cosf(angle), 0.f, sinf(angle));
+      ray.m_max_distance = 100.f;
+    }
+    std::vector<Aabb> regions(kNumRegions);
+    for(Aabb& region : regions) {
+      region.m_min = vec3(random_float(0.f, size), 0.f, random_float(0.f, size));
+      region.m_max = region.m_min + vec3(6.f, 2.f, 6.f);
+    }
+    
+    Bvh bvh;
+    Clock::time_point start = Clock::now();
+    bvh.Build(world);
+    const double build_s = get_seconds(start);
+    
+    std::vector<RayBatchHit> ray_hits;
+    start = Clock::now();
+    bvh.Raycast(rays.data(), kNumRays, ray_hits);
+    const double bvh_ray_s = get_seconds(start);
+    
+    std::vector<RayBatchHit> scan_ray_hits;
+    start = Clock::now();
+    for(uint32_t r = 0; r < kNumRays; ++r) {
+      RayBatchHit hit;
+      hit.m_ray = r;
+      if(raycast_brute(world, rays[r], hit.m_hit)) {
+        scan_ray_hits.push_back(hit);
+      }
+    }
+    const double scan_ray_s = get_seconds(start);
+    
+    bool rays_same = ray_hits.size() == scan_ray_hits.size();
+    for(size_t i = 0; rays_same && i < ray_hits.size(); ++i) {
+      rays_same = ray_hits[i].m_ray == scan_ray_hits[i].m_ray
+        && ray_hits[i].m_hit.m_entity == scan_ray_hits[i].m_hit.m_entity
+        && ray_hits[i].m_hit.m_distance == scan_ray_hits[i].m_hit.m_distance;
+    }
+    
+    std::vector<RegionBatchHit> region_hits;
+    start = Clock::now();
+    bvh.Query(regions.data(), kNumRegions, region_hits);
+    const double bvh_region_s = get_seconds(start);
+    
+    std::vector<RegionBatchHit> scan_region_hits;
+    start = Clock::now();
+    query_brute(world, regions.data(), kNumRegions, scan_region_hits);
+    const double scan_region_s = get_seconds(start);
+    const bool regions_same = same_region_hits(region_hits, scan_region_hits);
+    
+    const double bvh_ray_ns = bvh_ray_s * 1e9 / kNumRays;
+    const double scan_ray_ns = scan_ray_s * 1e9 / kNumRays;
+    const double bvh_region_ns = bvh_region_s * 1e9 / kNumRegions;
+    const double scan_region_ns = scan_region_s * 1e9 / kNumRegions;
+    printf("%10u %10.2f %12.0f %12.0f %8.1fx %12.0f %12.0f %8.1fx%s%s\n", count, build_s * 1e3,
+           bvh_ray_ns, scan_ray_ns, scan_ray_ns / bvh_ray_ns, bvh_region_ns, scan_region_ns, scan_region_ns / bvh_region_ns,
+           rays_same ? "" : "  RAY MISMATCH", regions_same ? "" : "  REGION MISMATCH");
+    same = same && rays_same && regions_same;
+  }
+  return same ? 0 : 1;
+}
@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include "common/movement.h"
+#include "common/world.h"
+
+// cost of the simulation in the number mode the binary is built in. built
+// twice, servsim_fixed_bench_float and servsim_fixed_bench_fixed, run both
+// to compare fixed-point with float: every movement kernel per entity, then
+// whole game steps including hashing.
+
+typedef std::chrono::steady_clock Clock;
+
+#if SERVSIM_FIXED_POINT
+static const char* kModeName = "fixed";
+#else
+static const char* kModeName = "float";
+#endif
+
+static const MoveKernel kKernels[] = { MoveKernel::kScalar, MoveKernel::kSse2, MoveKernel::kAvx2 };
+static const uint32_t kKernelEntities = 16384;
+static const uint32_t kKernelTicks = 4096;
+static const uint32_t kGameEntities = 100000;
+static const uint32_t kGameTicks = 200;
+
+static double run_kernel(MoveKernel kernel, uint32_t count, uint32_t ticks) {
+  std::vector<scalar_t> x(count);
+  std::vector<scalar_t> z(count);
+  std::vector<uint32_t> masks(count);
+  for(uint32_t i = 0; i < count; ++i) {
+    x[i] = to_scalar((float)(i % 1000));
+    z[i] = to_scalar((float)(i / 1000));
+    masks[i] = i % 4 != 0 ? ~0u : 0u;
+  }
+  const Clock::time_point start = Clock::now();
+  for(uint32_t t = 0; t < ticks; ++t) {
+    move_entities(kernel, x.data(), z.data(), masks.data(), (t % 32) << 1, count);
+  }
+  const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+  return elapsed * 1e9 / ((double)ticks * count);
+}
+
+static double run_game(const World& initial, uint64_t& hash) {
+  Game game;
+  game.Reset(0, initial);
+  const Clock::time_point start = Clock::now();
+  for(uint32_t t = 0; t < kGameTicks; ++t) {
+    game.UpdateInput(game.GetCurrentTick(), Input(2u << (t / 10 % 4)));
+    game.Step();
+  }
+  const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+  game.GetStateHash(game.GetCurrentTick(), hash);
+  return elapsed * 1e3 / kGameTicks;
+}
+
+int main(int argc, const char* argv[]) {
+  (void)argc;
+  (void)argv;
+  const MoveKernel supported = get_move_kernel();
+  printf("mode: %s, best kernel: %s\n", kModeName, get_move_kernel_name(supported));
+  
+  printf("%10s %12s\n", "kernel", "ns/entity");
+  for(MoveKernel kernel : kKernels) {
+    if((uint32_t)kernel > (uint32_t)supported) {
+      printf("%10s %12s\n", get_move_kernel_name(kernel), "unsupported");
+      continue;
+    }
+    run_kernel(kernel, kKernelEntities, 16);
+    printf("%10s %12.3f\n", get_move_kernel_name(kernel), run_kernel(kernel, kKernelEntities, kKernelTicks));
+  }
+  
+  World initial;
+  for(uint32_t i = 0; i < kGameEntities; ++i) {
+    Cube cube;
+    cube.m_translation = vec3((float)(i % 1000), 1.f, (float)(i / 1000));
+    initial.Spawn(cube, i % 4 != 0);
+  }
+  uint64_t hash = 0;
+  run_game(initial, hash);
+  const double ms = run_game(initial, hash);
+  printf("game step, %u entities: %.3f ms/tick, hash %016llx\n", kGameEntities, ms, (unsigned long long)hash);
+  return 0;
+}
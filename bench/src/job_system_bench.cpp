@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "common/job_system.h"
+#include "common/world.h"
+
+// step time of one large game with its entity updates split across 1 to N
+// job system threads. every thread count has to end on the same state hash.
+
+typedef std::chrono::steady_clock Clock;
+
+static const uint32_t kNumTicks = 200;
+
+static void print_usage(const char* name) {
+  printf("usage: %s [--entities <count>] [--max-threads <count>]\n", name);
+}
+
+static void build_world(World& world, uint32_t num_entities) {
+  for(uint32_t i = 0; i < num_entities; ++i) {
+    Cube cube;
+    cube.m_translation = vec3((float)(i % 1000), 1.f, (float)(i / 1000));
+    world.Spawn(cube, i % 4 != 0);
+  }
+}
+
+// steps a game from 'initial' and returns the final hash and the time per tick.
+static uint64_t run(const World& initial, JobSystem* jobs, double& ms_per_tick) {
+  Game game;
+  game.Reset(0, initial);
+  game.SetJobSystem(jobs);
+  const Clock::time_point start = Clock::now();
+  for(uint32_t t = 0; t < kNumTicks; ++t) {
+    game.UpdateInput(game.GetCurrentTick(), Input(2u << (t / 10 % 4)));
+    game.Step();
+  }
+  ms_per_tick = std::chrono::duration<double>(Clock::now() - start).count() * 1e3 / kNumTicks;
+  uint64_t hash = 0;
+  game.GetStateHash(game.GetCurrentTick(), hash);
+  return hash;
+}
+
+int main(int argc, const char* argv[]) {
+  uint32_t num_entities = 1000000;
+  uint32_t max_threads = std::thread::hardware_concurrency();
+  for(int i = 1; i < argc; ++i) {
+    const bool has_value = i + 1 < argc;
+    if(0 == strcmp(argv[i], "--entities") && has_value) {
+      num_entities = (uint32_t)atoi(argv[++i]);
+    } else if(0 == strcmp(argv[i], "--max-threads") && has_value) {
+      max_threads = (uint32_t)atoi(argv[++i]);
+    } else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+  max_threads = max_threads > 0 ? max_threads : 1;
+  
+  World initial;
+  build_world(initial, num_entities);
+  printf("%u entities, %u ticks, %u hardware threads\n", num_entities, kNumTicks, std::thread::hardware_concurrency());
+  printf("%8s %12s %10s %16s\n", "threads", "ms/tick", "speedup", "hash");
+  
+  // the first run only warms up the allocator and the caches.
+  double inline_ms;
+  run(initial, nullptr, inline_ms);
+  const uint64_t reference = run(initial, nullptr, inline_ms);
+  printf("%8s %12.3f %9.2fx %016llx\n", "inline", inline_ms, 1.0, (unsigned long long)reference);
+  
+  bool identical = true;
+  for(uint32_t threads = 1; threads <= max_threads; threads = threads < 4 ? threads + 1 : threads * 2) {
+    JobSystem jobs(threads);
+    double ms;
+    const uint64_t hash = run(initial, &jobs, ms);
+    identical = identical && hash == reference;
+    printf("%8u %12.3f %9.2fx %016llx%s\n", threads, ms, inline_ms / ms, (unsigned long long)hash,
+           hash == reference ? "" : "  MISMATCH");
+  }
+  return identical ? 0 : 1;
+}
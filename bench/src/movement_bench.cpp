@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include "common/input.h"
+#include "common/movement.h"
+
+// cost per entity of every movement kernel against the scalar loop, over
+// several entity counts. every kernel's output is compared with the scalar
+// one bit for bit.
+
+typedef std::chrono::steady_clock Clock;
+
+static const MoveKernel kKernels[] = { MoveKernel::kScalar, MoveKernel::kSse2, MoveKernel::kAvx2 };
+static const uint32_t kCounts[] = { 64, 1024, 16384, 262144 };
+// entities moved per measurement, so small counts run more often.
+static const uint64_t kEntitiesPerRun = 1 << 26;
+
+struct Columns {
+  std::vector<scalar_t> m_x;
+  std::vector<scalar_t> m_z;
+  std::vector<uint32_t> m_masks;
+};
+
+static void fill_columns(Columns& columns, uint32_t count) {
+  columns.m_x.resize(count);
+  columns.m_z.resize(count);
+  columns.m_masks.resize(count);
+  uint32_t seed = 12345;
+  for(uint32_t i = 0; i < count; ++i) {
+    seed = seed * 1664525u + 1013904223u;
+    columns.m_x[i] = to_scalar((float)(seed >> 16) / 1024.f);
+    columns.m_z[i] = to_scalar((float)(seed & 0xffff) / 1024.f);
+    // a quarter of the entities ignores the input.
+    columns.m_masks[i] = (seed >> 8) % 4 == 0 ? 0u : ~0u;
+  }
+}
+
+// buttons of the tick, cycling through every key and combinations of them.
+static uint32_t get_buttons(uint64_t tick) {
+  return (uint32_t)(tick % 32) << 1;
+}
+
+static double run_kernel(MoveKernel kernel, Columns& columns, uint64_t ticks) {
+  const uint32_t count = (uint32_t)columns.m_x.size();
+  const Clock::time_point start = Clock::now();
+  for(uint64_t t = 0; t < ticks; ++t) {
+    move_entities(kernel, columns.m_x.data(), columns.m_z.data(), columns.m_masks.data(), get_buttons(t), count);
+  }
+  const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+  return elapsed * 1e9 / ((double)ticks * count);
+}
+
+int main(int argc, const char* argv[]) {
+  (void)argc;
+  (void)argv;
+  const MoveKernel supported = get_move_kernel();
+#if SERVSIM_FIXED_POINT
+  printf("best kernel: %s, fixed-point\n", get_move_kernel_name(supported));
+#else
+  printf("best kernel: %s, float\n", get_move_kernel_name(supported));
+#endif
+  printf("%10s %10s %12s %10s\n", "entities", "kernel", "ns/entity", "speedup");
+  
+  bool identical = true;
+  for(uint32_t count : kCounts) {
+    const uint64_t ticks = kEntitiesPerRun / count;
+    Columns reference;
+    fill_columns(reference, count);
+    run_kernel(MoveKernel::kScalar, reference, ticks);
+    
+    double scalar_ns = 0.0;
+    for(MoveKernel kernel : kKernels) {
+      if((uint32_t)kernel > (uint32_t)supported) {
+        printf("%10u %10s %12s\n", count, get_move_kernel_name(kernel), "unsupported");
+        continue;
+      }
+      Columns columns;
+      fill_columns(columns, count);
+      // warms the caches, then measures from the same start as the reference.
+      run_kernel(kernel, columns, 1);
+      fill_columns(columns, count);
+      const double ns = run_kernel(kernel, columns, ticks);
+      scalar_ns = kernel == MoveKernel::kScalar ? ns : scalar_ns;
+      
+      const bool same = 0 == memcmp(columns.m_x.data(), reference.m_x.data(), count * sizeof(scalar_t))
+        && 0 == memcmp(columns.m_z.data(), reference.m_z.data(), count * sizeof(scalar_t));
+      identical = identical && same;
+      printf("%10u %10s %12.3f %9.2fx%s\n", count, get_move_kernel_name(kernel), ns, scalar_ns / ns,
+             same ? "" : "  MISMATCH");
+    }
+  }
+  return identical ? 0 : 1;
+}
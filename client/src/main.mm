@@ -93,6 +93,7 @@ Input create_input(const DeviceInput& device) {
   
   m_renderer = new Renderer();
   m_game = new Game();
+  m_game->SetKeepPreviousState(true);
 }
 
 -(void)keyDown:(NSEvent *)event
@@ -229,9 +230,10 @@ static float clamp(float v, float min, float max) {
   if(input.IsAnyDown()) {
     m_game->UpdateInput(input);
   }
-  m_game->Update(16.f);
+  const uint64_t now = TickScheduler::NowNs();
+  m_game->Update(now);
   m_renderer->BeginScene(m_window_dimension.x, m_window_dimension.y);
-  m_renderer->RenderWorld(m_camera_position, camera_forward, m_game->GetCurrentState());
+  m_renderer->RenderWorld(m_camera_position, camera_forward, m_game->GetInterpolatedStateAt(now));
   m_renderer->EndScene();
 
   [[self openGLContext] makeCurrentContext];
@@ -445,7 +445,7 @@ void Renderer::BeginScene(int width, int height) {
   gl_check_error("beginscene");
 }
 
-void Renderer::RenderWorld(vec3 cameraPosition, vec3 cameraForward, const World& world) {
+void Renderer::RenderWorld(vec3 cameraPosition, vec3 cameraForward, const InterpolatedWorld& world) {
 #if 0
   const vec3 lookAt = model_translation;
 #else
@@ -457,17 +457,11 @@ void Renderer::RenderWorld(vec3 cameraPosition, vec3 cameraForward, const World&
   const mat4 projection = perspective(40.f, m_ar, 0.1f, 100.f);
   //const mat4 projection = ortho(-10.f, 10.f, -10.f, 10.f, 0.1f, 100.f);
   
-  {
-    const mat4 model = create_model(world.m_cube.m_translation, world.m_cube.m_rotation, world.m_cube.m_scale);
-    render_object(m_programId, m_cubeVao, m_cubeVbo, m_cubeIbo, sizeof(kCubeIndices) / sizeof(kCubeIndices[0]),
-                  vec3(1.f, 0.f, 1.f), model, view, projection, cameraPosition);
-  }
-  {
-    const mat4 model = create_model(world.m_cube.m_translation + vec3(4.f, 0.f, 0.f),
-                                    world.m_cube.m_rotation + M_PI_2,
-                                    world.m_cube.m_scale * 0.5f);
+  for(uint32_t i = 0; i < world.GetNumEntities(); ++i) {
+    const Cube cube = world.GetCube(i);
+    const mat4 model = create_model(cube.m_translation, cube.m_rotation, cube.m_scale);
     render_object(m_programId, m_cubeVao, m_cubeVbo, m_cubeIbo, sizeof(kCubeIndices) / sizeof(kCubeIndices[0]),
-                  vec3(0.f, 1.f, 1.f), model, view, projection, cameraPosition);
+                  cube.m_color, model, view, projection, cameraPosition);
   }
   {
     const mat4 model = create_model(vec3::kZero, 0.f, 10000.f);
@@ -2,7 +2,7 @@
 #include <stdint.h>
 #include "common/mat4.h"
 
-struct World;
+class InterpolatedWorld;
 
 class Renderer {
 public:
@@ -10,7 +10,7 @@ public:
   ~Renderer();
   
   void BeginScene(int width, int height);
-  void RenderWorld(vec3 cameraPosition, vec3 cameraForward, const World& world);
+  void RenderWorld(vec3 cameraPosition, vec3 cameraForward, const InterpolatedWorld& world);
   void EndScene();
 private:
   uint32_t m_programId;
@@ -0,0 +1,67 @@
+#pragma once
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// packs values of arbitrary bit width into bytes, least significant bit first.
+
+class BitWriter {
+public:
+  BitWriter();
+  
+  // 'value' must fit into 'num_bits', at most 32.
+  void Write(uint32_t value, uint32_t num_bits) {
+    assert(num_bits <= 32);
+    assert(num_bits == 32 || value < (1ull << num_bits));
+    // less than 32 bits are pending, so 32 more always fit the scratch.
+    m_scratch |= (uint64_t)value << m_scratch_bits;
+    m_scratch_bits += num_bits;
+    m_num_bits += num_bits;
+    if(m_scratch_bits >= 32) {
+      FlushWord();
+    }
+  }
+  void WriteBool(bool value) { Write(value ? 1 : 0, 1); }
+  // variable length, groups of 'group_bits' each followed by a continue bit.
+  // small group sizes suit values that are usually small.
+  void WriteVar(uint64_t value, uint32_t group_bits);
+  // zigzag coded, small magnitudes of either sign stay short.
+  void WriteSignedVar(int64_t value, uint32_t group_bits);
+  
+  // pads the last byte with zeros, later writes start on a byte boundary.
+  void Flush();
+  void Clear();
+  
+  uint32_t GetNumBits() const { return m_num_bits; }
+  // written data up to the last full 32 bits, Flush() first to include the rest.
+  const std::vector<uint8_t>& GetData() const { return m_data; }
+  
+private:
+  void FlushWord();
+  
+private:
+  std::vector<uint8_t> m_data;
+  uint64_t m_scratch;
+  uint32_t m_scratch_bits;
+  uint32_t m_num_bits;
+};
+
+// reads what a BitWriter wrote. every read fails instead of running past
+// the end of the data, so malformed packets are safe to read.
+class BitReader {
+public:
+  BitReader(const uint8_t* data, size_t size);
+  
+  bool Read(uint32_t& value, uint32_t num_bits);
+  bool ReadBool(bool& value);
+  bool ReadVar(uint64_t& value, uint32_t group_bits);
+  bool ReadSignedVar(int64_t& value, uint32_t group_bits);
+  
+  size_t GetNumBitsLeft() const { return m_size * 8 - m_bit; }
+  
+private:
+  const uint8_t* m_data;
+  size_t m_size;
+  size_t m_bit;
+};
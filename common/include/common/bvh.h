@@ -0,0 +1,101 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include "collision.h"
+#include "vec3.h"
+#include "world.h"
+
+struct Ray {
+  vec3 m_origin;
+  vec3 m_direction;  // unit length.
+  float m_max_distance = 1e30f;
+};
+
+// hit of one ray of a batch.
+struct RayBatchHit {
+  uint32_t m_ray;
+  RayHit m_hit;
+};
+
+// entity overlapping one region of a batch.
+struct RegionBatchHit {
+  uint32_t m_region;
+  entity_t m_entity;
+};
+
+struct BvhConfig {
+  uint32_t m_leaf_size = 4;       // entities per leaf at most.
+  float m_rebuild_ratio = 1.5f;   // Update() rebuilds once the node surface area grew by this since the last build.
+};
+
+struct BvhStats {
+  uint64_t m_num_builds = 0;
+  uint64_t m_num_refits = 0;
+  uint32_t m_num_nodes = 0;
+  float m_quality = 1.f;          // node surface area relative to the last build, higher is worse.
+};
+
+// bounding volume hierarchy over the cubes of a world, for ray and region
+// queries. built top-down by median splits, then kept up to date by
+// refitting the node bounds to the moved entities each tick, which keeps the
+// topology. as entities drift apart from the ones they were grouped with the
+// nodes grow, once they grew too much the tree is rebuilt.
+//
+// nodes are stored depth first, a node's first child follows it, so refits
+// are one pass backwards over the array. entity boxes are copied into the
+// leaves, queries do not touch the world.
+class Bvh {
+public:
+  explicit Bvh(const BvhConfig& config = BvhConfig());
+  
+  void Build(const World& world);
+  // refits to the current positions. rebuilds if entities were spawned or
+  // despawned since the last build or the quality dropped below the config.
+  void Update(const World& world);
+  
+  // nearest entity hit by the ray, ties go to the lower id.
+  bool Raycast(const Ray& ray, RayHit& hit) const;
+  // hits of many rays, in ray order. rays that miss are left out.
+  void Raycast(const Ray* rays, uint32_t count, std::vector<RayBatchHit>& hits) const;
+  // entities overlapping the region, in no particular order.
+  void Query(const Aabb& region, std::vector<entity_t>& entities) const;
+  // entities of many regions, in region order.
+  void Query(const Aabb* regions, uint32_t count, std::vector<RegionBatchHit>& hits) const;
+  
+  const BvhStats& GetStats() const { return m_stats; }
+  
+private:
+  // internal nodes have no entities, their second child is at m_first.
+  struct Node {
+    float m_min[3];
+    float m_max[3];
+    uint32_t m_first;
+    uint32_t m_count;
+  };
+  
+  struct Item {
+    CubeBox m_box;
+    Aabb m_bounds;
+    entity_t m_entity;
+    uint32_t m_index;  // dense index in the world it was built from.
+  };
+  
+  // deeper nodes are not split, bounds the traversal stacks.
+  static const uint32_t kMaxDepth = 48;
+  
+private:
+  void BuildNode(uint32_t first, uint32_t count, uint32_t depth);
+  // calls func with every entity overlapping the region, batches append
+  // straight to their hits without a list per region.
+  template<typename Func>
+  void ForEachOverlap(const Aabb& region, Func func) const;
+  // fits all nodes to the item bounds and returns their total surface area.
+  float Refit();
+  
+private:
+  BvhConfig m_config;
+  BvhStats m_stats;
+  std::vector<Node> m_nodes;
+  std::vector<Item> m_items;
+  float m_build_area;
+};
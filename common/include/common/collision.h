@@ -0,0 +1,116 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include "vec3.h"
+#include "world.h"
+
+// cube collision. cubes span [-scale, scale] around their translation and
+// only rotate around the y axis, so their bounds on the ground plane are
+// squares and boxes are compared with a separating axis test on x/z and an
+// interval test on y. all of it runs on float copies of the positions.
+
+struct EntityPair {
+  uint32_t m_a;  // dense indices, m_a < m_b.
+  uint32_t m_b;
+};
+
+struct CubeBox {
+  vec3 m_center;
+  float m_half_extent;
+  float m_rotation;  // around y.
+};
+
+// bounds of a square rotated by any angle, in half extents.
+static const float kRotatedExtent = 1.41421356f;
+
+// axis aligned, e.g. a region of a query.
+struct Aabb {
+  vec3 m_min;
+  vec3 m_max;
+};
+
+struct RayHit {
+  entity_t m_entity = 0;
+  float m_distance = 0.f; // along the ray, 0 if the origin is inside the box.
+  vec3 m_point;
+};
+
+CubeBox get_cube_box(const World& world, uint32_t index);
+// tight bounds of the rotated cube.
+Aabb get_cube_bounds(const CubeBox& box);
+// narrowphase, true if the boxes touch or overlap.
+bool overlap_aabb(const CubeBox& a, const CubeBox& b);
+bool overlap_obb(const CubeBox& a, const CubeBox& b);
+bool overlap_region(const Aabb& region, const CubeBox& box);
+// distance along the ray from 'origin' in unit 'direction' to where it
+// enters the box, 0 if it starts inside. false if that is past 'max_distance'.
+bool intersect_ray(const CubeBox& box, const vec3& origin, const vec3& direction, float max_distance, float& distance);
+
+// broadphase over the ground plane. entities are sorted into a hashed
+// uniform grid by their x/z bounds, pairs sharing a cell are candidates.
+// rebuilding is a counting sort over preallocated arrays, cheap enough to run
+// every resimulated tick.
+class SpatialGrid {
+public:
+  // cells around the size of a typical cube keep the candidate lists short.
+  explicit SpatialGrid(float cell_size = 2.f);
+  
+  void Build(const World& world);
+  // bounds cover every entity of 'world' both where it is there and where
+  // the same id is in 'next', for queries anywhere between the two states.
+  void Build(const World& world, const World& next);
+  
+  // pairs with overlapping bounds that share a cell, each pair once.
+  void FindPairs(std::vector<EntityPair>& pairs) const;
+  // candidates narrowed down with overlap_obb().
+  void FindOverlaps(const World& world, std::vector<EntityPair>& pairs) const;
+  // entities whose bounds overlap the x/z rectangle, each once.
+  void Query(float min_x, float min_z, float max_x, float max_z, std::vector<uint32_t>& indices) const;
+  // entities whose cells the x/z segment from 'x', 'z' along 'dir_x', 'dir_z'
+  // times 'length' passes, each once, in no particular order.
+  void QueryRay(float x, float z, float dir_x, float dir_z, float length, std::vector<uint32_t>& indices) const;
+  
+  uint32_t GetNumEntities() const { return (uint32_t)m_bounds.size(); }
+  
+private:
+  struct Bounds {
+    float m_min_x;
+    float m_min_z;
+    float m_max_x;
+    float m_max_z;
+  };
+  
+  struct CellRange {
+    int32_t m_min_x;
+    int32_t m_min_z;
+    int32_t m_max_x;
+    int32_t m_max_z;
+  };
+  
+  // entity in one cell. carries a copy of the entity's bounds and first
+  // cell, so pair tests only read the bucket.
+  struct Cell {
+    int32_t m_x;
+    int32_t m_z;
+    uint32_t m_index;
+    int32_t m_min_x;
+    int32_t m_min_z;
+    Bounds m_bounds;
+  };
+  
+private:
+  int32_t ToCell(float value) const;
+  // sorts the entities into cells by the bounds already in m_bounds.
+  void Insert();
+  uint32_t Bucket(int32_t x, int32_t z) const;
+  static bool Overlap(const Bounds& a, const Bounds& b);
+  
+private:
+  float m_cell_size;
+  float m_inv_cell_size;
+  uint32_t m_bucket_mask;
+  std::vector<Bounds> m_bounds;
+  std::vector<CellRange> m_ranges;
+  std::vector<uint32_t> m_bucket_start;  // bucket b holds m_cells[start[b], start[b + 1]).
+  std::vector<Cell> m_cells;
+};
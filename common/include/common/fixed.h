@@ -0,0 +1,186 @@
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+
+// signed 16.16 fixed-point number. all arithmetic is integer, so results are
+// the same on every compiler, optimization level and cpu. trivially copyable,
+// so arrays of it can be memcpy'd and hashed like the float ones.
+// adds, subtracts and negations wrap around in two's complement like the
+// simd kernels' 32-bit lanes, instead of overflowing.
+class fixed {
+public:
+  static const int32_t kFractionBits = 16;
+  static const int32_t kOneRaw = 1 << kFractionBits;
+  
+  static const fixed kZero;
+  static const fixed kOne;
+
+  inline fixed();
+
+  // rounds to the nearest representable value.
+  static inline fixed from_float(float value);
+  static inline fixed from_int(int32_t value);
+  static inline fixed from_raw(int32_t raw);
+
+  inline float to_float() const;
+  inline int32_t raw() const;
+
+  inline fixed &operator+=(fixed);
+  inline fixed &operator-=(fixed);
+  inline fixed &operator*=(fixed);
+  inline fixed &operator/=(fixed);
+
+  inline fixed operator+() const;
+  inline fixed operator-() const;
+
+  inline fixed operator+(fixed) const;
+  inline fixed operator-(fixed) const;
+  inline fixed operator*(fixed) const;
+  inline fixed operator/(fixed) const;
+
+  inline bool operator==(fixed) const;
+  inline bool operator!=(fixed) const;
+  inline bool operator<(fixed) const;
+  inline bool operator<=(fixed) const;
+  inline bool operator>(fixed) const;
+  inline bool operator>=(fixed) const;
+
+private:
+  int32_t m_raw;
+};
+
+// vector of fixed-point numbers, the deterministic counterpart of vec3.
+class fixed3 {
+public:
+  static const fixed3 kZero;
+
+  inline fixed3();
+  inline fixed3(fixed x, fixed y, fixed z);
+
+  inline fixed3 &operator+=(const fixed3 &);
+  inline fixed3 &operator-=(const fixed3 &);
+
+  inline fixed3 operator-() const;
+  inline fixed3 operator+(const fixed3 &) const;
+  inline fixed3 operator-(const fixed3 &) const;
+  inline fixed3 operator*(fixed) const;
+
+  inline bool operator==(const fixed3 &) const;
+  inline bool operator!=(const fixed3 &) const;
+
+  inline fixed dot(const fixed3 &v) const;
+
+public:
+  fixed x, y, z;
+};
+
+fixed::fixed() : m_raw(0) {}
+
+fixed fixed::from_float(float value) {
+  return from_raw((int32_t)floorf(value * (float)kOneRaw + 0.5f));
+}
+
+fixed fixed::from_int(int32_t value) {
+  return from_raw((int32_t)((uint32_t)value << kFractionBits));
+}
+
+fixed fixed::from_raw(int32_t raw) {
+  fixed result;
+  result.m_raw = raw;
+  return result;
+}
+
+float fixed::to_float() const {
+  return m_raw / (float)kOneRaw;
+}
+
+int32_t fixed::raw() const { return m_raw; }
+
+fixed &fixed::operator+=(fixed v) {
+  *this = *this + v;
+  return *this;
+}
+
+fixed &fixed::operator-=(fixed v) {
+  *this = *this - v;
+  return *this;
+}
+
+fixed &fixed::operator*=(fixed v) {
+  *this = *this * v;
+  return *this;
+}
+
+fixed &fixed::operator/=(fixed v) {
+  *this = *this / v;
+  return *this;
+}
+
+fixed fixed::operator+() const { return *this; }
+
+fixed fixed::operator-() const { return from_raw((int32_t)(0u - (uint32_t)m_raw)); }
+
+fixed fixed::operator+(fixed v) const { return from_raw((int32_t)((uint32_t)m_raw + (uint32_t)v.m_raw)); }
+
+fixed fixed::operator-(fixed v) const { return from_raw((int32_t)((uint32_t)m_raw - (uint32_t)v.m_raw)); }
+
+fixed fixed::operator*(fixed v) const {
+  return from_raw((int32_t)(((int64_t)m_raw * v.m_raw) >> kFractionBits));
+}
+
+fixed fixed::operator/(fixed v) const {
+  return from_raw((int32_t)((int64_t)m_raw * kOneRaw / v.m_raw));
+}
+
+bool fixed::operator==(fixed v) const { return m_raw == v.m_raw; }
+bool fixed::operator!=(fixed v) const { return m_raw != v.m_raw; }
+bool fixed::operator<(fixed v) const { return m_raw < v.m_raw; }
+bool fixed::operator<=(fixed v) const { return m_raw <= v.m_raw; }
+bool fixed::operator>(fixed v) const { return m_raw > v.m_raw; }
+bool fixed::operator>=(fixed v) const { return m_raw >= v.m_raw; }
+
+fixed3::fixed3() {}
+
+fixed3::fixed3(fixed _x, fixed _y, fixed _z)
+    : x(_x), y(_y), z(_z) {}
+
+fixed3 &fixed3::operator+=(const fixed3 &v) {
+  x += v.x;
+  y += v.y;
+  z += v.z;
+  return *this;
+}
+
+fixed3 &fixed3::operator-=(const fixed3 &v) {
+  x -= v.x;
+  y -= v.y;
+  z -= v.z;
+  return *this;
+}
+
+fixed3 fixed3::operator-() const { return fixed3(-x, -y, -z); }
+
+fixed3 fixed3::operator+(const fixed3 &v) const {
+  return fixed3(x + v.x, y + v.y, z + v.z);
+}
+
+fixed3 fixed3::operator-(const fixed3 &v) const {
+  return fixed3(x - v.x, y - v.y, z - v.z);
+}
+
+fixed3 fixed3::operator*(fixed a) const {
+  return fixed3(x * a, y * a, z * a);
+}
+
+bool fixed3::operator==(const fixed3 &v) const {
+  return x == v.x && y == v.y && z == v.z;
+}
+
+bool fixed3::operator!=(const fixed3 &v) const {
+  return x != v.x || y != v.y || z != v.z;
+}
+
+fixed fixed3::dot(const fixed3 &v) const {
+  return x * v.x + y * v.y + z * v.z;
+}
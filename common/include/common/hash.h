@@ -0,0 +1,51 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// fast non-cryptographic 64-bit hashing, in the spirit of xxhash64.
+// results only depend on the bytes, not on the platform's alignment rules,
+// so peers on the same endianness agree.
+
+static const uint64_t kHashPrime1 = 0x9E3779B185EBCA87ull;
+static const uint64_t kHashPrime2 = 0xC2B2AE3D27D4EB4Full;
+static const uint64_t kHashPrime3 = 0x165667B19E3779F9ull;
+static const uint64_t kHashPrime4 = 0x85EBCA77C2B2AE63ull;
+
+inline uint64_t hash_rotl(uint64_t value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+// final avalanche, every input bit affects every output bit.
+inline uint64_t hash_finalize(uint64_t h) {
+  h ^= h >> 33;
+  h *= kHashPrime2;
+  h ^= h >> 29;
+  h *= kHashPrime3;
+  h ^= h >> 32;
+  return h;
+}
+
+inline uint64_t hash_combine(uint64_t h, uint64_t value) {
+  h ^= hash_rotl(value * kHashPrime2, 31) * kHashPrime1;
+  return hash_rotl(h, 27) * kHashPrime1 + kHashPrime4;
+}
+
+inline uint64_t hash_bytes(const void* data, size_t size, uint64_t seed = 0) {
+  const uint8_t* bytes = (const uint8_t*)data;
+  uint64_t h = seed + kHashPrime3 + size;
+  
+  size_t i = 0;
+  for(; i + 8 <= size; i += 8) {
+    uint64_t word;
+    memcpy(&word, bytes + i, 8);
+    h = hash_combine(h, word);
+  }
+  
+  if(i < size) {
+    uint64_t tail = 0;
+    memcpy(&tail, bytes + i, size - i);
+    h = hash_combine(h, tail);
+  }
+  return hash_finalize(h);
+}
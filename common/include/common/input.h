@@ -1,4 +1,5 @@
 #pragma once
+#include <stdint.h>
 
 struct Input {
   enum class Key : uint32_t {
@@ -8,14 +9,29 @@ struct Input {
     kRight = 4
   };
   
+  Input() = default;
+  explicit Input(uint32_t buttons) : m_buttons(buttons) {}
+  
   bool IsKeyDown(Key key) const {
     return 0 != (m_buttons & (1 << (uint32_t)key));
   }
   
+  uint32_t GetButtons() const {
+    return m_buttons;
+  }
+  
   bool IsAnyDown() const {
     return m_buttons != 0;
   }
   
+  bool operator==(const Input& other) const {
+    return m_buttons == other.m_buttons;
+  }
+  
+  bool operator!=(const Input& other) const {
+    return m_buttons != other.m_buttons;
+  }
+  
   void SetKeyDown(Key key) {
     m_buttons |= (1 << (uint32_t)key);
   }
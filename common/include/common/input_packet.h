@@ -0,0 +1,55 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include "bit_stream.h"
+#include "input.h"
+#include "tick.h"
+
+// every input packet repeats the inputs of the last few ticks, so a packet
+// that arrives fills in for the ones lost before it. receivers apply only
+// the ticks they did not have yet, rewriting a known tick rolls the game back.
+//
+// layout: newest tick (var), tick count - 1 (var), then runs of equal inputs
+// from the newest tick back: buttons (kInputButtonBits) and run length - 1 (var).
+// a window of held keys costs a few bytes no matter its length.
+
+static const uint32_t kMaxInputWindow = 64;
+// every key bit of Input::Key.
+static const uint32_t kInputButtonBits = 5;
+
+struct InputPacket {
+  tick_t m_newest_tick = 0;
+  uint32_t m_count = 0;
+  Input m_inputs[kMaxInputWindow];  // newest first, m_inputs[i] is for tick m_newest_tick - i.
+  
+  tick_t GetTick(uint32_t index) const { return m_newest_tick - index; }
+};
+
+// returns false if the packet holds no or too many inputs, reaches before
+// tick 0 or an input has buttons outside of kInputButtonBits.
+bool write_input_packet(const InputPacket& packet, BitWriter& writer);
+// returns false if the data is truncated or malformed.
+bool read_input_packet(BitReader& reader, InputPacket& packet);
+
+// sender side sliding window over the last inputs of one client.
+class InputWindow {
+public:
+  // 'length' ticks per packet, at most kMaxInputWindow.
+  explicit InputWindow(uint32_t length = 32);
+  
+  // input of the tick after the newest one. any other tick restarts the window.
+  void Push(tick_t tick, const Input& input);
+  void Clear() { m_count = 0; }
+  
+  uint32_t GetCount() const { return m_count; }
+  tick_t GetNewestTick() const { return m_newest_tick; }
+  
+  // the window as a packet, false while it is empty.
+  bool GetPacket(InputPacket& packet) const;
+  bool Write(BitWriter& writer) const;
+  
+private:
+  std::vector<Input> m_inputs;
+  uint32_t m_count;
+  tick_t m_newest_tick;
+};
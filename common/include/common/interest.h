@@ -0,0 +1,84 @@
+#pragma once
+#include <stdint.h>
+#include <memory>
+#include <vector>
+#include "collision.h"
+#include "snapshot.h"
+#include "world.h"
+
+struct InterestConfig {
+  float m_enter_radius = 20.f;  // entities closer than this become relevant.
+  float m_leave_radius = 24.f;  // relevant entities stay until they are further than this.
+  float m_cell_size = 8.f;      // cells of the entity grid.
+};
+
+struct InterestStats {
+  uint32_t m_num_clients = 0;
+  uint32_t m_num_groups = 0;        // grid queries of the last update, one per group of close clients.
+  uint64_t m_num_candidates = 0;    // distance tests of the last update.
+  uint64_t m_num_relevant = 0;      // entities in all interest sets.
+  uint64_t m_update_ns = 0;
+};
+
+// per-client relevancy. every client has a focus point on the ground plane,
+// each update keeps the entities around it in the client's interest set,
+// which then limits its snapshots. the leave radius is larger than the
+// enter radius, so entities on the border do not flicker in and out.
+//
+// updates build one grid over the world. clients whose focus falls into the
+// same leave radius sized cell are grouped and share one grid query, each
+// of them only tests the entities that query returned.
+class InterestManager {
+public:
+  typedef std::shared_ptr<const InterestSet> InterestSetRef;
+  
+public:
+  explicit InterestManager(const InterestConfig& config = InterestConfig());
+  
+  uint32_t AddClient();
+  void RemoveClient(uint32_t client);
+  void SetFocus(uint32_t client, float x, float z);
+  
+  void Update(const World& world);
+  
+  // sets are immutable and only replaced when they change, a client keeps the
+  // one it was sent for as the baseline interest of later snapshots.
+  const InterestSetRef& GetInterest(uint32_t client) const { return m_clients[client].m_interest; }
+  const InterestStats& GetStats() const { return m_stats; }
+  
+private:
+  struct Client {
+    bool m_active = false;
+    float m_x = 0.f;
+    float m_z = 0.f;
+    InterestSetRef m_interest;
+  };
+  
+  // entity returned by a group query, read once for all of its clients.
+  struct Candidate {
+    float m_x;
+    float m_z;
+    entity_t m_entity;
+  };
+  
+  struct GroupEntry {
+    uint64_t m_key;  // focus cell.
+    uint32_t m_client;
+    
+    bool operator<(const GroupEntry& other) const { return m_key < other.m_key; }
+  };
+  
+private:
+  void UpdateClient(Client& client);
+  
+private:
+  InterestConfig m_config;
+  InterestStats m_stats;
+  SpatialGrid m_grid;
+  std::vector<Client> m_clients;
+  std::vector<uint32_t> m_free_clients;
+  std::vector<GroupEntry> m_groups;
+  std::vector<uint32_t> m_indices;
+  std::vector<Candidate> m_candidates;
+  InterestSet m_scratch;
+};
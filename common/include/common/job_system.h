@@ -0,0 +1,62 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// work-stealing scheduler for data-parallel loops.
+// every thread owns a queue of ranges, pops from its back and steals from the
+// front of the others when it runs dry. the calling thread takes part in the
+// work, so a system with one thread runs everything inline.
+class JobSystem {
+public:
+  typedef std::function<void(uint32_t begin, uint32_t end)> RangeFunc;
+  
+public:
+  // 0 threads picks one per hardware core.
+  explicit JobSystem(uint32_t num_threads = 0);
+  ~JobSystem();
+  
+  JobSystem(const JobSystem&) = delete;
+  JobSystem& operator=(const JobSystem&) = delete;
+  
+  // number of threads running jobs, including the caller.
+  uint32_t GetNumThreads() const { return (uint32_t)m_queues.size(); }
+  
+  // calls func over [0, count) split into ranges of at most chunk_size and
+  // blocks until all of them ran. ranges never overlap, so func is safe to
+  // write to its own range without synchronization.
+  void ParallelFor(uint32_t count, uint32_t chunk_size, const RangeFunc& func);
+  
+private:
+  struct Job {
+    const RangeFunc* m_func;
+    uint32_t m_begin;
+    uint32_t m_end;
+    std::atomic<uint32_t>* m_remaining;
+  };
+  
+  struct Queue {
+    std::mutex m_mutex;
+    std::deque<Job> m_jobs;
+  };
+  
+private:
+  void WorkerMain(uint32_t index);
+  bool Pop(uint32_t index, Job& job);
+  bool Steal(uint32_t index, Job& job);
+  bool FindJob(uint32_t index, Job& job);
+  static void Run(const Job& job);
+  
+private:
+  std::vector<Queue*> m_queues; // index 0 belongs to the calling thread.
+  std::vector<std::thread> m_threads;
+  std::mutex m_wake_mutex;
+  std::condition_variable m_wake;
+  uint64_t m_wake_generation;
+  bool m_quit;
+};
@@ -0,0 +1,72 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include "collision.h"
+#include "vec3.h"
+#include "world.h"
+
+struct LagCompensationStats {
+  uint64_t m_num_queries = 0;
+  uint64_t m_num_builds = 0;      // queries that missed the cache and rebuilt a tick.
+  uint64_t m_num_candidates = 0;  // narrowphase tests of all queries.
+};
+
+// hit tests against the world as a client saw it, some ticks in the past
+// and between two ticks by its render interpolation.
+//
+// states come from the game's history as shared copies, nothing is copied
+// per query. the first query of a tick builds a grid over that tick and the
+// next one, later queries of the same tick reuse it. cached ticks are checked
+// against Game::GetStateHash(), so a rollback that changed them rebuilds.
+class LagCompensator {
+public:
+  explicit LagCompensator(Game& game, uint32_t cache_size = 4, float cell_size = 2.f);
+  
+  // nearest entity the ray hits at 'tick' + 'alpha', alpha in [0, 1] blends
+  // towards the next tick. 'direction' is unit length.
+  // returns false if nothing is hit or the tick is outside of the history window.
+  bool Raycast(tick_t tick, float alpha, const vec3& origin, const vec3& direction, float max_distance, RayHit& hit);
+  // entities overlapping 'box' at 'tick' + 'alpha', sorted by id.
+  // returns false if the tick is outside of the history window.
+  bool Overlap(tick_t tick, float alpha, const CubeBox& box, std::vector<entity_t>& entities);
+  // box of one entity at 'tick' + 'alpha'.
+  // returns false if the entity does not exist at 'tick' or the tick is outside of the window.
+  bool GetBox(tick_t tick, float alpha, entity_t entity, CubeBox& box);
+  
+  // drops all cached ticks.
+  void Clear();
+  const LagCompensationStats& GetStats() const { return m_stats; }
+  
+private:
+  static const tick_t kNoTick = ~(tick_t)0;
+  static const uint32_t kNoIndex = ~0u;
+  
+  // one tick and the next, with a grid covering both.
+  struct Entry {
+    tick_t m_tick = kNoTick;
+    uint64_t m_hash = 0;
+    uint64_t m_next_hash = 0;
+    bool m_has_next = false;  // false for the current tick.
+    uint64_t m_last_used = 0;
+    World m_state;
+    World m_next;
+    std::vector<uint32_t> m_next_index;  // index in m_next per entity of m_state, kNoIndex if despawned.
+    SpatialGrid m_grid;
+    
+    explicit Entry(float cell_size) : m_grid(cell_size) {}
+  };
+  
+private:
+  // cached entry of 'tick', rebuilt if missing or stale. null outside of the window.
+  const Entry* Acquire(tick_t tick);
+  // shares the state of 'tick' from another entry if one has it.
+  bool FindCached(tick_t tick, uint64_t hash, World& state) const;
+  static CubeBox InterpolateBox(const Entry& entry, uint32_t index, float alpha);
+  
+private:
+  Game& m_game;
+  std::vector<Entry> m_entries;
+  uint64_t m_use_count;
+  LagCompensationStats m_stats;
+  std::vector<uint32_t> m_indices;
+};
@@ -0,0 +1,87 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+
+// always-on counters of the tick loop. every metric has one writing thread,
+// which updates it with relaxed atomic stores and no locks, and can be read
+// by any thread at any time. a snapshot taken while the writer is running
+// may be off by the values it is recording.
+
+// adds to a counter only one thread writes. a relaxed load and store do not
+// need a locked read-modify-write.
+template<typename T>
+inline void add_relaxed(std::atomic<T>& counter, T value) {
+  counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+struct HistogramSnapshot {
+  static const uint32_t kNumBuckets = 32;
+  
+  uint64_t m_buckets[kNumBuckets] = {};
+  uint64_t m_sum = 0;
+  uint64_t m_max = 0;
+  
+  uint64_t GetCount() const;
+  double GetMean() const;
+  // upper bound of the values below the quantile 'q' in [0, 1], exact up to
+  // the bucket size and never above the max.
+  uint64_t GetQuantile(double q) const;
+  // merges the values of 'other', e.g. of many sessions.
+  void Add(const HistogramSnapshot& other);
+  
+  // bucket 0 holds 0, bucket b > 0 holds [2^(b-1), 2^b), the last one all larger values.
+  static uint32_t GetBucket(uint64_t value);
+  static uint64_t GetBucketLimit(uint32_t bucket);
+};
+
+// histogram of power of two buckets.
+class Histogram {
+public:
+  Histogram();
+  // copies the values with relaxed loads, only while no thread records.
+  Histogram(const Histogram& other) noexcept;
+  Histogram& operator=(const Histogram& other) noexcept;
+  
+  // only called by the writing thread.
+  void Record(uint64_t value);
+  void GetSnapshot(HistogramSnapshot& snapshot) const;
+  
+private:
+  std::atomic<uint64_t> m_buckets[HistogramSnapshot::kNumBuckets];
+  std::atomic<uint64_t> m_sum;
+  std::atomic<uint64_t> m_max;
+};
+
+struct GameMetricsSnapshot {
+  HistogramSnapshot m_step_ns;          // duration of every step.
+  HistogramSnapshot m_resimulated;      // ticks simulated by every step, above 1 rolled back.
+  HistogramSnapshot m_ticks_due;        // ticks due at once when the game was stepped, above 1 fell behind.
+  HistogramSnapshot m_input_lateness;   // ticks every accepted input arrived after its tick, 0 if on time or early.
+  uint64_t m_num_rejected_inputs = 0;   // inputs outside of the history window.
+  
+  void Add(const GameMetricsSnapshot& other);
+};
+
+// tick loop metrics of one game, written by the thread stepping it.
+class GameMetrics {
+public:
+  GameMetrics();
+  // copies the values, only while no thread records, e.g. when a game is
+  // moved before it runs.
+  GameMetrics(const GameMetrics& other) noexcept;
+  GameMetrics& operator=(const GameMetrics& other) noexcept;
+  
+  void RecordStep(uint64_t duration_ns, uint32_t resimulated);
+  void RecordTicksDue(uint64_t ticks) { m_ticks_due.Record(ticks); }
+  void RecordInput(uint64_t lateness) { m_input_lateness.Record(lateness); }
+  void RecordRejectedInput();
+  
+  void GetSnapshot(GameMetricsSnapshot& snapshot) const;
+  
+private:
+  Histogram m_step_ns;
+  Histogram m_resimulated;
+  Histogram m_ticks_due;
+  Histogram m_input_lateness;
+  std::atomic<uint64_t> m_num_rejected_inputs;
+};
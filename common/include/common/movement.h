@@ -0,0 +1,30 @@
+#pragma once
+#include <stdint.h>
+#include "scalar.h"
+
+// per-tick movement update over packed position columns.
+// every lane decodes its own button bitmask (buttons & masks[i]) into a
+// direction and moves along it by a fixed delta per tick. all kernels give bit-identical
+// results, lanes that do not move keep their exact previous value.
+
+enum class MoveKernel {
+  kScalar,
+  kSse2,
+  kAvx2,
+};
+
+// best kernel supported by the cpu, detected once.
+MoveKernel get_move_kernel();
+const char* get_move_kernel_name(MoveKernel kernel);
+
+// true if any lane would move, i.e. move_entities would write.
+bool moves_any_entity(const uint32_t* masks, uint32_t buttons, uint32_t count);
+
+void move_entities(scalar_t* x, scalar_t* z, const uint32_t* masks, uint32_t buttons, uint32_t count);
+
+// every lane brings its own buttons, already masked, e.g. lanes holding
+// entities of different games.
+void move_lanes(scalar_t* x, scalar_t* z, const uint32_t* lane_buttons, uint32_t count);
+
+// runs a specific kernel, falls back to scalar if the cpu does not support it.
+void move_entities(MoveKernel kernel, scalar_t* x, scalar_t* z, const uint32_t* masks, uint32_t buttons, uint32_t count);
@@ -0,0 +1,48 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include "snapshot.h"
+#include "world.h"
+
+struct PredictionStats {
+  uint64_t m_num_snapshots = 0;     // authoritative snapshots checked.
+  uint64_t m_num_misses = 0;        // snapshots that differed from the prediction.
+  uint64_t m_num_resimulated = 0;   // ticks resimulated because of misses.
+  uint32_t m_last_resimulated = 0;
+};
+
+// client side prediction. the client steps its own game ahead of the server
+// with local inputs, authoritative snapshots are checked against the state it
+// predicted for their tick. on a miss the snapshot overwrites that state and
+// the ticks after it are resimulated from the buffered local inputs on the
+// next Step(). fewer ticks of input delay mean more ticks to resimulate.
+// the snapshot's entity set is authoritative too: entities it lacks are
+// despawned and new ones spawned, uncontrolled and with the default scale
+// and color, so snapshots have to carry every entity the client simulates.
+class ClientPrediction {
+public:
+  // predicted fields may be off by 'tolerance' quantization steps, the
+  // quantized authoritative state is not exact either.
+  explicit ClientPrediction(Game& game, const SnapshotConfig& config = SnapshotConfig(), uint32_t tolerance = 1);
+  
+  // returns false if the snapshot is not newer than the last one, ahead of
+  // the game or outside of its history window.
+  bool ApplySnapshot(const Snapshot& snapshot);
+  
+  const PredictionStats& GetStats() const { return m_stats; }
+  
+private:
+  // writes the snapshot over the entities of m_predicted that are off,
+  // missing or not in the snapshot. returns true if any was.
+  bool Correct(const Snapshot& snapshot);
+  
+private:
+  Game& m_game;
+  SnapshotConfig m_config;
+  int64_t m_tolerance;
+  PredictionStats m_stats;
+  World m_predicted;
+  std::vector<entity_t> m_despawned;
+  bool m_has_snapshot;
+  tick_t m_snapshot_tick;
+};
@@ -0,0 +1,162 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include "world.h"
+
+// input recordings. a replay file is a header followed by records in the
+// order they were written: every input a recorded game accepted, tagged with
+// the tick the game was at when it arrived, and keyframes of whole worlds.
+// keyframes are only written once no input can change their tick any more,
+// so playing the inputs on from a keyframe reproduces the game exactly.
+//
+// files are written and read through memory maps. the file grows in large
+// steps and its unused tail stays zeroed, so a file cut off by a crash still
+// reads up to the last complete record.
+
+struct ReplayConfig {
+  uint32_t m_keyframe_interval = 600; // ticks between keyframes of a game.
+};
+
+struct ReplayRecorderStats {
+  uint64_t m_num_inputs = 0;
+  uint64_t m_num_keyframes = 0;
+  uint64_t m_num_bytes = 0;
+};
+
+// records any number of games into one file, told apart by a session id.
+// not thread safe, threads recording games in parallel use a file each.
+class ReplayRecorder {
+public:
+  ReplayRecorder();
+  ~ReplayRecorder();
+  
+  ReplayRecorder(const ReplayRecorder&) = delete;
+  ReplayRecorder& operator=(const ReplayRecorder&) = delete;
+  
+  // creates or truncates 'path'. returns false if it can not be created or mapped.
+  bool Open(const char* path, const ReplayConfig& config = ReplayConfig());
+  // records where every game ended and cuts the file to the recorded size.
+  void Close();
+  bool IsOpen() const { return m_data != nullptr; }
+  
+  // starts recording a game that was just constructed or reset, its current
+  // state becomes the first keyframe.
+  bool AddSession(uint32_t session, const Game& game);
+  // an input the game accepted at its current tick.
+  bool RecordInput(uint32_t session, const Game& game, tick_t tick, const Input& input);
+  // call after every step of a recorded game.
+  bool RecordStep(uint32_t session, Game& game);
+  
+  const ReplayRecorderStats& GetStats() const { return m_stats; }
+  
+private:
+  struct Session {
+    bool m_active = false;
+    uint32_t m_history_length = 0;
+    tick_t m_first_tick = 0;
+    tick_t m_tick = 0;
+    // file size when the game reached each of the last ticks, by tick.
+    std::vector<uint64_t> m_tick_offset;
+  };
+  
+private:
+  bool Append(uint32_t type, const void* payload, size_t payload_size, const void* data, size_t data_size);
+  bool Reserve(size_t size);
+  bool WriteKeyframe(uint32_t session, const Session& state, tick_t tick, const World& world);
+  
+private:
+  ReplayConfig m_config;
+  ReplayRecorderStats m_stats;
+  int m_file;
+  uint8_t* m_data;
+  size_t m_size;
+  size_t m_capacity;
+  std::vector<Session> m_sessions;
+};
+
+struct ReplayPlayerStats {
+  uint64_t m_num_steps = 0;
+  uint64_t m_num_inputs = 0;
+  uint64_t m_num_checked = 0;     // keyframes passed and compared with the replayed state.
+  uint64_t m_num_mismatches = 0;
+  tick_t m_first_mismatch = 0;    // tick of the first keyframe that did not match.
+};
+
+// plays a recorded session back into a game as fast as it steps, there is
+// no wall clock pacing. seeking restarts the game from a keyframe, so a
+// desync is found by checking which keyframes still match after playing
+// and bisecting the ticks in between.
+class ReplayPlayer {
+public:
+  ReplayPlayer();
+  ~ReplayPlayer();
+  
+  ReplayPlayer(const ReplayPlayer&) = delete;
+  ReplayPlayer& operator=(const ReplayPlayer&) = delete;
+  
+  // maps 'path' and indexes its keyframes. returns false if it can not be
+  // read, is not a replay or was recorded by an incompatible build.
+  bool Open(const char* path);
+  void Close();
+  
+  void GetSessions(std::vector<uint32_t>& sessions) const;
+  // keyframe ticks of a session, ascending.
+  void GetKeyframes(uint32_t session, std::vector<tick_t>& ticks) const;
+  // last tick the session was recorded at, or the last one its records name
+  // if the file was cut off. returns false for unknown sessions.
+  bool GetLastTick(uint32_t session, tick_t& tick) const;
+  // history length of the recorded game, the game played back into must
+  // have the same. returns false for unknown sessions.
+  bool GetHistoryLength(uint32_t session, uint32_t& length) const;
+  
+  // resets 'game' to the last keyframe of 'session' at or before 'tick',
+  // later Play() calls continue from there.
+  // returns false if there is none, its world is malformed or the game has
+  // a different history length.
+  bool Seek(uint32_t session, tick_t tick, Game& game);
+  // steps 'game' to 'tick', feeding it every input the session received up
+  // to then. states older than the history length are final, later ones may
+  // still change with inputs that arrive after 'tick'.
+  // keyframes are compared with the game as it passes them.
+  bool Play(Game& game, tick_t tick);
+  
+  const ReplayPlayerStats& GetStats() const { return m_stats; }
+  
+private:
+  struct Keyframe {
+    uint32_t m_session;
+    uint32_t m_history_length;
+    tick_t m_tick;
+    uint64_t m_hash;
+    size_t m_offset;      // of the record.
+    size_t m_scan_offset; // first record that can hold an input for a later tick.
+    
+    bool operator<(const Keyframe& other) const {
+      return m_session != other.m_session ? m_session < other.m_session : m_tick < other.m_tick;
+    }
+  };
+  
+  struct LastTick {
+    uint32_t m_session;
+    tick_t m_tick;
+  };
+  
+private:
+  void Step(Game& game);
+  
+private:
+  ReplayPlayerStats m_stats;
+  int m_file;
+  const uint8_t* m_data;
+  size_t m_size;
+  uint32_t m_history_length;
+  std::vector<Keyframe> m_keyframes;
+  std::vector<LastTick> m_last_ticks;
+  
+  // playback position.
+  uint32_t m_session;
+  tick_t m_first_tick;
+  size_t m_cursor;
+  size_t m_next_keyframe; // next keyframe of the session to compare.
+  size_t m_end_keyframe;
+};
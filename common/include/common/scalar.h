@@ -0,0 +1,30 @@
+#pragma once
+
+#include "fixed.h"
+#include "vec3.h"
+
+// numeric type of the simulation state. builds with SERVSIM_FIXED_POINT
+// simulate in 16.16 fixed-point so peers built with different compilers or
+// flags stay bit-identical, others simulate in float.
+
+#if SERVSIM_FIXED_POINT
+
+typedef fixed scalar_t;
+typedef fixed3 scalar3;
+
+inline scalar_t to_scalar(float value) { return fixed::from_float(value); }
+inline float to_float(scalar_t value) { return value.to_float(); }
+inline scalar3 to_scalar(const vec3& v) { return fixed3(to_scalar(v.x), to_scalar(v.y), to_scalar(v.z)); }
+inline vec3 to_float(const scalar3& v) { return vec3(to_float(v.x), to_float(v.y), to_float(v.z)); }
+
+#else
+
+typedef float scalar_t;
+typedef vec3 scalar3;
+
+inline scalar_t to_scalar(float value) { return value; }
+inline float to_float(scalar_t value) { return value; }
+inline scalar3 to_scalar(const vec3& v) { return v; }
+inline vec3 to_float(const scalar3& v) { return v; }
+
+#endif
@@ -0,0 +1,117 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "replay.h"
+#include "world.h"
+
+typedef uint32_t session_t;
+
+struct SessionHostConfig {
+  uint32_t m_num_threads = 0;         // 0 picks one per hardware core.
+  uint32_t m_tick_rate = 10;          // ticks per second of every session.
+  uint32_t m_checkpoint_interval = 1; // history checkpoint interval of every session.
+  uint32_t m_history_length = Game::kDefaultHistoryLength; // rollback window of every session, in ticks.
+  bool m_pin_threads = true;          // pin each shard thread to one core, where supported.
+  uint32_t m_batch_lanes = 0;         // due sessions stepped together per Game::StepBatch(), 0 steps one by one.
+  std::string m_replay_path;          // records every shard to '<path>.<shard>', empty records nothing.
+  ReplayConfig m_replay;
+};
+
+struct SessionHostStats {
+  uint32_t m_num_sessions = 0;
+  uint32_t m_num_shards = 0;
+  uint64_t m_num_steps = 0;
+  uint64_t m_num_late_steps = 0;  // steps that ran a full tick period after they were due.
+  uint64_t m_num_passes = 0;
+  uint64_t m_step_ns = 0;         // time spent inside Game::Step().
+  uint64_t m_max_step_ns = 0;     // slowest step, or slowest batch when batching.
+  uint64_t m_busy_ns = 0;         // time shard threads spent in scheduler passes.
+};
+
+// runs many independent games on a few threads. sessions are dealt to shards,
+// every shard owns its games in one contiguous pool and is stepped by one
+// thread, so a game is only ever touched by the thread of its shard.
+// each scheduler pass steps every session of the shard that is due.
+// only the Game objects are pooled, the history rings and world chunks they
+// own are still separate heap allocations.
+class SessionHost {
+public:
+  explicit SessionHost(const SessionHostConfig& config);
+  ~SessionHost();
+  
+  SessionHost(const SessionHost&) = delete;
+  SessionHost& operator=(const SessionHost&) = delete;
+  
+  // adds a session, only valid before Start().
+  session_t AddSession();
+  
+  // returns false if a replay file can not be created, nothing runs then.
+  bool Start();
+  void Stop();
+  bool IsRunning() const { return !m_threads.empty(); }
+  
+  // queues input for a session, applied by its shard thread before the next
+  // pass. safe to call from any thread. returns false for unknown sessions.
+  bool PostInput(session_t session, tick_t tick, const Input& input);
+  
+  uint32_t GetNumSessions() const { return m_num_sessions; }
+  uint32_t GetNumShards() const { return (uint32_t)m_shards.size(); }
+  
+  // sums the stats of all shards. safe to call while running.
+  SessionHostStats GetStats() const;
+  // tick loop metrics of one session, returns false for unknown sessions.
+  // safe to call while running.
+  bool GetSessionMetrics(session_t session, GameMetricsSnapshot& snapshot) const;
+  // metrics of all sessions merged. safe to call while running.
+  void GetMetrics(GameMetricsSnapshot& snapshot) const;
+  
+  // only valid while stopped.
+  const Game& GetSession(session_t session) const;
+  
+private:
+  struct QueuedInput {
+    uint32_t m_local;
+    tick_t m_tick;
+    Input m_input;
+  };
+  
+  // stats are written by the shard thread only and read by anyone. every
+  // shard is a separate allocation, so threads do not share its cache lines.
+  struct Shard {
+    uint32_t m_index;
+    std::vector<Game> m_games;
+    std::vector<uint64_t> m_next_due_ns; // next step time of every game.
+    
+    std::mutex m_input_mutex;
+    std::vector<QueuedInput> m_input_queue;
+    std::vector<QueuedInput> m_input_work;
+    std::vector<Game*> m_due_games;
+    ReplayRecorder m_recorder;  // open if recording.
+    
+    std::atomic<uint64_t> m_num_steps;
+    std::atomic<uint64_t> m_num_late_steps;
+    std::atomic<uint64_t> m_num_passes;
+    std::atomic<uint64_t> m_step_ns;
+    std::atomic<uint64_t> m_max_step_ns;
+    std::atomic<uint64_t> m_busy_ns;
+  };
+  
+private:
+  void CloseReplays();
+  void ShardMain(uint32_t index);
+  uint64_t RunPass(Shard& shard, uint64_t now_ns);
+  // session of the game at 'local' in 'shard'.
+  session_t GetSessionId(const Shard& shard, size_t local) const { return (session_t)(local * m_shards.size() + shard.m_index); }
+  
+private:
+  SessionHostConfig m_config;
+  uint64_t m_tick_period_ns;
+  uint32_t m_num_sessions;
+  std::vector<Shard*> m_shards;
+  std::vector<std::thread> m_threads;
+  std::atomic<bool> m_quit;
+};
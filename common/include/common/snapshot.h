@@ -0,0 +1,105 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include "bit_stream.h"
+#include "world.h"
+
+// world replication. positions and rotations are quantized to a fixed step,
+// a snapshot only carries the entities that changed since a baseline state
+// the client already has, and of those only the changed fields as deltas.
+//
+// layout: tick (var), has baseline (1), baseline tick distance (var),
+// despawned count (var) and id gaps (var), changed count (var), then per
+// changed entity: id gap (var), new (1), new entities all fields as values,
+// others a 4 bit field mask and the changed fields as deltas (signed var).
+
+struct SnapshotConfig {
+  float m_position_step = 1.f / 1024.f; // quantization step of positions, world units.
+  float m_rotation_step = 1.f / 1024.f; // radians.
+  uint32_t m_history_length = 32;       // ticks of sent snapshots kept as baselines.
+};
+
+struct SnapshotEntity {
+  static const uint32_t kNumFields = 4;
+  
+  entity_t m_entity;
+  int32_t m_fields[kNumFields]; // quantized x, y, z, rotation.
+};
+
+// quantized world state, entities sorted by id.
+struct Snapshot {
+  tick_t m_tick = 0;
+  std::vector<SnapshotEntity> m_entities;
+};
+
+// sorted ids of the entities a client receives, others are left out of its
+// snapshots as if they did not exist. null sets stand for all entities.
+typedef std::vector<entity_t> InterestSet;
+
+struct SnapshotHeader {
+  tick_t m_tick = 0;
+  tick_t m_baseline_tick = 0;
+  bool m_has_baseline = false;
+};
+
+void quantize_world(const World& world, tick_t tick, const SnapshotConfig& config, Snapshot& snapshot);
+void quantize_entity(const World& world, uint32_t index, const SnapshotConfig& config, SnapshotEntity& entity);
+scalar3 get_snapshot_position(const SnapshotEntity& entity, const SnapshotConfig& config);
+scalar_t get_snapshot_rotation(const SnapshotEntity& entity, const SnapshotConfig& config);
+// keeps the entities of 'snapshot' that are in 'interest'.
+void filter_snapshot(const Snapshot& snapshot, const InterestSet& interest, Snapshot& filtered);
+
+// writes 'current' as delta against 'baseline', which is older. null writes all entities.
+void write_snapshot(const Snapshot& current, const Snapshot* baseline, BitWriter& writer);
+// reading takes two steps, the header names the baseline the rest needs.
+bool read_snapshot_header(BitReader& reader, SnapshotHeader& header);
+// 'baseline' must be the snapshot of header.m_baseline_tick if it has one.
+// returns false if the data is malformed or the baseline is missing.
+bool read_snapshot(BitReader& reader, const SnapshotHeader& header, const Snapshot* baseline, Snapshot& snapshot);
+
+struct SnapshotStats {
+  uint64_t m_num_snapshots = 0;
+  uint64_t m_num_delta_snapshots = 0;
+  uint64_t m_num_bytes = 0;
+  uint64_t m_num_entities = 0;  // entities in the encoded worlds.
+  uint64_t m_encode_ns = 0;     // quantizing, diffing and packing.
+  uint32_t m_last_bytes = 0;
+  
+  double GetBytesPerSnapshot() const { return m_num_snapshots ? (double)m_num_bytes / m_num_snapshots : 0.0; }
+  double GetEncodeNsPerEntity() const { return m_num_entities ? (double)m_encode_ns / m_num_entities : 0.0; }
+};
+
+// server side encoder. baselines are the snapshots it sent before, not the
+// game's history, which changes when late inputs resimulate past ticks.
+class SnapshotEncoder {
+public:
+  explicit SnapshotEncoder(const SnapshotConfig& config = SnapshotConfig());
+  
+  // writes the current state of 'game' with all entities of 'interest'.
+  void Encode(const Game& game, BitWriter& writer, const InterestSet* interest = nullptr);
+  // writes the current state of 'game' as delta against the one sent for
+  // 'baseline_tick' to a client that had 'baseline_interest' then. falls back
+  // to all entities and returns false if that snapshot is no longer kept.
+  bool Encode(const Game& game, tick_t baseline_tick, BitWriter& writer,
+              const InterestSet* interest = nullptr, const InterestSet* baseline_interest = nullptr);
+  
+  const SnapshotConfig& GetConfig() const { return m_config; }
+  const SnapshotStats& GetStats() const { return m_stats; }
+  
+private:
+  static const tick_t kNoTick = ~(tick_t)0;
+  
+private:
+  // quantizes the current tick once and keeps it as a baseline.
+  const Snapshot& Capture(const Game& game);
+  const Snapshot* FindSent(tick_t tick) const;
+  void Write(const Snapshot& current, const Snapshot* baseline, BitWriter& writer, uint64_t start_ns);
+  
+private:
+  SnapshotConfig m_config;
+  SnapshotStats m_stats;
+  std::vector<Snapshot> m_sent;
+  std::vector<tick_t> m_sent_tick;
+  Snapshot m_current;
+  Snapshot m_baseline;
+};
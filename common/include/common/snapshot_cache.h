@@ -0,0 +1,63 @@
+#pragma once
+#include <stdint.h>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "snapshot.h"
+
+// encoded snapshot, immutable once handed out.
+struct SnapshotPacket {
+  tick_t m_tick = 0;
+  tick_t m_baseline_tick = 0;
+  bool m_has_baseline = false;
+  std::vector<uint8_t> m_data;
+};
+
+typedef std::shared_ptr<const SnapshotPacket> SnapshotPacketRef;
+
+struct SnapshotCacheStats {
+  uint64_t m_num_requests = 0;
+  uint64_t m_num_encodes = 0;   // requests no earlier one of the tick matched.
+};
+
+// encodes every distinct snapshot of a tick once. clients that acked the same
+// baseline and receive the same interest set get the same packet, shared
+// between them. one cache per game, entries live until the game's tick moves on.
+class SnapshotCache {
+public:
+  explicit SnapshotCache(const SnapshotConfig& config = SnapshotConfig());
+  
+  // current state of 'game' with all entities of 'interest'.
+  SnapshotPacketRef Get(const Game& game, const InterestSet* interest = nullptr);
+  // current state of 'game' as delta against 'baseline_tick', see SnapshotEncoder::Encode().
+  SnapshotPacketRef Get(const Game& game, tick_t baseline_tick,
+                        const InterestSet* interest = nullptr, const InterestSet* baseline_interest = nullptr);
+  
+  const SnapshotEncoder& GetEncoder() const { return m_encoder; }
+  const SnapshotCacheStats& GetStats() const { return m_stats; }
+  
+private:
+  struct Entry {
+    bool m_has_baseline;
+    tick_t m_baseline_tick;
+    bool m_has_interest;
+    bool m_has_baseline_interest;
+    InterestSet m_interest;
+    InterestSet m_baseline_interest;
+    SnapshotPacketRef m_packet;
+  };
+  
+private:
+  SnapshotPacketRef Find(const Game& game, bool has_baseline, tick_t baseline_tick,
+                         const InterestSet* interest, const InterestSet* baseline_interest);
+  static bool Matches(const Entry& entry, bool has_baseline, tick_t baseline_tick,
+                      const InterestSet* interest, const InterestSet* baseline_interest);
+  
+private:
+  SnapshotEncoder m_encoder;
+  SnapshotCacheStats m_stats;
+  // keyed by the hash of the request, entries compare the full request.
+  std::unordered_multimap<uint64_t, Entry> m_entries;
+  tick_t m_tick;
+  BitWriter m_writer;
+};
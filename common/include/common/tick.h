@@ -0,0 +1,5 @@
+#pragma once
+#include <stdint.h>
+
+// simulation step number, counted from 0 and never wrapping.
+typedef uint64_t tick_t;
@@ -0,0 +1,59 @@
+#pragma once
+#include <stdint.h>
+
+// what Update() does with ticks still due after running the most it may.
+enum class OverrunPolicy {
+  kSkip,      // drops them, the schedule jumps to the clock and the game falls behind it for good.
+  kSlowDown,  // keeps them due, later updates catch up while the game runs slower than the clock.
+};
+
+struct TickSchedulerConfig {
+  uint64_t m_tick_period_ns = 100000000;
+  uint32_t m_max_steps_per_update = 4;  // catch-up cap, at least 1.
+  OverrunPolicy m_overrun_policy = OverrunPolicy::kSkip;
+};
+
+struct TickSchedulerStats {
+  uint64_t m_num_updates = 0;
+  uint64_t m_num_steps = 0;
+  uint64_t m_num_catch_up_steps = 0;  // steps after the first of an update.
+  uint64_t m_num_overruns = 0;        // updates that hit the cap with ticks still due.
+  uint64_t m_num_skipped_ticks = 0;   // ticks dropped by OverrunPolicy::kSkip.
+  uint32_t m_last_steps = 0;          // steps of the last update.
+  uint32_t m_max_steps = 0;           // most steps of one update.
+  uint64_t m_lag_ns = 0;              // how long the next tick was overdue after the last update.
+  uint64_t m_max_lag_ns = 0;
+  uint64_t m_max_update_interval_ns = 0;  // longest time between two updates.
+};
+
+// fixed timestep on a monotonic nanosecond clock. due times are whole tick
+// periods from the first update, kept as integers, so they do not drift
+// however long it runs. a stall is caught up by at most the configured
+// number of steps per update, the rest is handled by the overrun policy.
+class TickScheduler {
+public:
+  explicit TickScheduler(const TickSchedulerConfig& config = TickSchedulerConfig());
+  
+  // number of ticks to step at 'now_ns', the schedule moves past them.
+  // the first call only starts the clock, the first tick is due one period later.
+  uint32_t Update(uint64_t now_ns);
+  // starts over at the next Update(), e.g. after a reset or a long pause.
+  void Restart() { m_started = false; }
+  
+  // how far 'now_ns' is from the last tick towards the next one, in [0, 1].
+  float GetAlpha(uint64_t now_ns) const;
+  
+  const TickSchedulerConfig& GetConfig() const { return m_config; }
+  void SetConfig(const TickSchedulerConfig& config);
+  const TickSchedulerStats& GetStats() const { return m_stats; }
+  
+  // steady clock in nanoseconds.
+  static uint64_t NowNs();
+  
+private:
+  TickSchedulerConfig m_config;
+  TickSchedulerStats m_stats;
+  bool m_started;
+  uint64_t m_next_due_ns;
+  uint64_t m_last_update_ns;
+};
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <string>
+#include <string.h>
+#include <assert.h>
 #include <math.h>
 
 class vec3 {
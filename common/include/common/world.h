@@ -1,9 +1,21 @@
 #pragma once
+#include <memory>
+#include <unordered_set>
+#include <vector>
 #include "vec3.h"
+#include "scalar.h"
 #include "input.h"
+#include "metrics.h"
+#include "tick.h"
+#include "tick_scheduler.h"
 
-typedef uint64_t tick_t;
+class BitReader;
+class BitWriter;
+class JobSystem;
 
+typedef uint32_t entity_t;
+
+// value view of a single entity, converted to float for rendering.
 struct Cube {
   vec3 m_translation = vec3::kZero;
   float m_rotation = 0.f;
@@ -11,27 +23,280 @@ struct Cube {
   vec3 m_color = vec3(1.f, 0.f, 1.f);
 };
 
-struct World {
-  Cube m_cube;
+// hot entity data for kChunkSize consecutive dense indices. chunks are
+// shared between worlds and only copied when a shared one gets written.
+struct EntityChunk {
+  static const uint32_t kSize = 64;
+  
+  scalar_t m_position_x[kSize];
+  scalar_t m_position_y[kSize];
+  scalar_t m_position_z[kSize];
+  scalar_t m_rotation[kSize];
+  
+  // hash of the data above, computed on demand and reset by writes.
+  uint64_t m_hash = 0;
+  bool m_hash_valid = false;
+};
+
+// entity store. every component is a column indexed by a dense entity index
+// in [0, GetNumEntities()), entity ids stay stable and map to the dense index.
+// hot columns live in copy-on-write chunks, cold columns in one copy-on-write
+// layout that only changes when entities are spawned, despawned or edited.
+// copying a world shares all of its data, writes unshare what they touch.
+class World {
+public:
+  static const entity_t kInvalidEntity = ~(entity_t)0;
+  
+public:
+  World();
+  
+  // shares all chunks and the layout of 'other'.
+  void CopyFrom(const World& other);
+  
+  entity_t Spawn(const Cube& cube, bool controlled);
+  // spawns with an id picked elsewhere, e.g. by a server. returns false if
+  // the id is taken.
+  bool SpawnWithId(entity_t entity, const Cube& cube, bool controlled);
+  void Despawn(entity_t entity);
+  
+  uint32_t GetNumEntities() const { return (uint32_t)m_layout->m_entity.size(); }
+  entity_t GetEntity(uint32_t index) const { return m_layout->m_entity[index]; }
+  // returns false if the entity does not exist.
+  bool FindIndex(entity_t entity, uint32_t& index) const;
+  
+  Cube GetCube(uint32_t index) const;
+  // exact simulation position.
+  scalar3 GetTranslation(uint32_t index) const;
+  void SetColor(uint32_t index, const vec3& color);
+  void SetScale(uint32_t index, float scale);
+  
+  // hot columns, chunk c holds dense indices [c * kSize, c * kSize + count).
+  uint32_t GetNumChunks() const { return (uint32_t)m_chunks.size(); }
+  uint32_t GetChunkEntities(uint32_t chunk) const;
+  const EntityChunk& GetChunk(uint32_t chunk) const { return *m_chunks[chunk]; }
+  // copies the chunk first if another world still references it.
+  EntityChunk& GetMutableChunk(uint32_t chunk);
+  
+  // hash of the whole state. chunks cache their hash, so this only rehashes
+  // data written since the chunks were last hashed.
+  uint64_t GetHash() const;
+  
+  // cold columns.
+  const float* GetScale() const { return m_layout->m_scale.data(); }
+  const vec3* GetColor() const { return m_layout->m_color.data(); }
+  // ~0 for entities moved by the game input, 0 otherwise.
+  const uint32_t* GetInputMask() const { return m_layout->m_input_mask.data(); }
+  
+  // exact copy of every column, reading it back gives a world with the same
+  // hash that spawns the same ids. Read() returns false on malformed data.
+  void Write(BitWriter& writer) const;
+  bool Read(BitReader& reader);
+  
+  // bytes allocated by this world, including the object itself.
+  size_t GetMemoryUsage() const;
+  // adds the bytes of data not in 'counted' yet, so shared chunks are only
+  // counted once across many worlds.
+  void CollectMemoryUsage(std::unordered_set<const void*>& counted, size_t& bytes) const;
+  
+private:
+  struct Layout {
+    std::vector<float> m_scale;
+    std::vector<vec3> m_color;
+    std::vector<uint32_t> m_input_mask;
+    std::vector<entity_t> m_entity; // dense index -> entity id.
+    std::vector<uint32_t> m_index;  // entity id -> dense index.
+    std::vector<entity_t> m_free_entities;
+    uint64_t m_hash = 0;
+    bool m_hash_valid = false;
+  };
+  
+private:
+  Layout& GetMutableLayout();
+  // appends the columns of a new entity with a reserved id.
+  void Insert(entity_t entity, const Cube& cube, bool controlled);
+  
+private:
+  std::vector<std::shared_ptr<EntityChunk>> m_chunks;
+  std::shared_ptr<Layout> m_layout;
+};
+
+// read-only view between two states of a game for rendering, e.g. the
+// previous and the current tick. it only references the two worlds, nothing
+// is copied, and stays valid until either of them changes.
+class InterpolatedWorld {
+public:
+  // alpha in [0, 1] blends from 'from' to 'to'.
+  InterpolatedWorld(const World& from, const World& to, float alpha);
+  
+  // entities are the ones of 'to'.
+  uint32_t GetNumEntities() const { return m_to.GetNumEntities(); }
+  entity_t GetEntity(uint32_t index) const { return m_to.GetEntity(index); }
+  // cube at 'alpha' between both states. entities spawned in between are
+  // shown where they are in 'to'.
+  Cube GetCube(uint32_t index) const;
+  float GetAlpha() const { return m_alpha; }
+  
+private:
+  const World& m_from;
+  const World& m_to;
+  float m_alpha;
+};
+
+// simulation cost of the last and all previous steps.
+struct StepStats {
+  uint32_t m_last_resimulated = 0;  // ticks simulated by the last Step()
+  uint64_t m_total_resimulated = 0; // ticks simulated since construction
+  uint64_t m_num_steps = 0;
+};
+
+// cost of rebuilding past states from checkpoints.
+struct HistoryStats {
+  uint32_t m_last_query_resimulated = 0;  // ticks simulated by the last GetState()
+  uint64_t m_total_query_resimulated = 0;
+  uint64_t m_num_queries = 0;
 };
 
 class Game {
 public:
-  Game();
-  void Update(float dt);
+  static const uint32_t kDefaultHistoryLength = 100;
+  
+  // keeps a full world every 'checkpoint_interval' ticks of history, states
+  // in between are resimulated from the closest earlier checkpoint on demand.
+  // 1 keeps every tick. 'history_length' ticks of states and inputs are kept,
+  // the input and hash rings are rounded up to a power of two.
+  explicit Game(uint32_t checkpoint_interval = 1, uint32_t history_length = kDefaultHistoryLength);
+  // steps every tick the scheduler has due at 'now_ns', a monotonic clock
+  // like TickScheduler::NowNs(). the first call starts the clock.
+  // returns the number of steps.
+  uint32_t Update(uint64_t now_ns);
+  // advances the simulation by exactly one tick, for callers keeping time themselves.
+  void Step();
+  
+  // steps 'count' games by one tick each. groups of up to 'lanes' games move
+  // their entities in one pass, every simd lane holding a different game.
+  // every game ends up exactly as if Step() was called on it.
+  static const uint32_t kMaxBatchLanes = 16;
+  static void StepBatch(Game* const* games, uint32_t count, uint32_t lanes = kMaxBatchLanes);
+  
   void UpdateInput(const Input& input);
-  const World& GetCurrentState() const { return m_state[m_current_tick]; }
+  
+  // sets input for an arbitrary tick. past ticks inside the history window
+  // trigger a resimulation from that tick on the next Step(), future ticks
+  // are buffered until the game reaches them.
+  // returns false if the tick is outside of the window in either direction.
+  bool UpdateInput(tick_t tick, const Input& input);
+  
+  tick_t GetCurrentTick() const { return m_current_tick; }
+  const World& GetCurrentState() const { return m_current_state; }
+  // keeps the state of the previous tick for rendering between ticks. it
+  // shares every chunk nothing moved in since, moved ones are copied once per
+  // tick. off by default, servers do not render.
+  void SetKeepPreviousState(bool keep);
+  // the current state while the previous one is not kept.
+  const World& GetPreviousState() const { return m_keep_previous_state ? m_previous_state : m_current_state; }
+  // the previous and the current state blended by 'alpha', for rendering
+  // between ticks one tick behind the simulation.
+  InterpolatedWorld GetInterpolatedState(float alpha) const { return InterpolatedWorld(GetPreviousState(), m_current_state, alpha); }
+  // blended by how far 'now_ns' is into the current tick of Update().
+  InterpolatedWorld GetInterpolatedStateAt(uint64_t now_ns) const { return GetInterpolatedState(m_scheduler.GetAlpha(now_ns)); }
+  const StepStats& GetStepStats() const { return m_step_stats; }
+  // step times, rollbacks, catch-up and input lateness. safe to read from
+  // any thread while the game is stepped, see GameMetrics.
+  const GameMetrics& GetMetrics() const { return m_metrics; }
+  // for callers stepping the game on their own schedule to record how many
+  // ticks were due at once.
+  GameMetrics& GetMetrics() { return m_metrics; }
+  
+  // hash of the state of a tick inside the history window, as of the last
+  // Step(). returns false if the tick is outside of the window.
+  bool GetStateHash(tick_t tick, uint64_t& hash) const;
+  
+  // rebuilds the state of a tick inside the history window into 'state'.
+  // returns false if the tick is outside of the window.
+  bool GetState(tick_t tick, World& state);
+  
+  // replaces the state of a tick inside the history window, e.g. with an
+  // authoritative one from a server. later states are resimulated from it on
+  // the next Step(), inputs of earlier ticks no longer change them. earlier
+  // states are not rebuilt and may still be predictions.
+  // returns false if the tick is outside of the window.
+  bool SetState(tick_t tick, const World& state);
+  // restarts the game at 'tick' from 'state' with an empty history, as if it
+  // was constructed there. states and inputs of earlier ticks are gone.
+  void Reset(tick_t tick, const World& state);
+  const HistoryStats& GetHistoryStats() const { return m_history_stats; }
+  
+  // ticks of states and inputs kept, inputs older than this are rejected.
+  uint32_t GetHistoryLength() const { return m_history_length; }
+  
+  uint32_t GetCheckpointInterval() const { return m_checkpoint_interval; }
+  // bytes used by the input and state history.
+  size_t GetHistoryMemoryUsage() const;
+  
+  // splits the entity updates of every tick across the job system threads.
+  // results do not depend on the number of threads. null runs inline.
+  void SetJobSystem(JobSystem* jobs) { m_jobs = jobs; }
+  
+  // tick period, catch-up cap and overrun policy of Update().
+  void SetSchedulerConfig(const TickSchedulerConfig& config) { m_scheduler.SetConfig(config); }
+  const TickScheduler& GetScheduler() const { return m_scheduler; }
   
 private:
-  static const uint32_t kGameLoopLength = 100;
+  static const tick_t kInvalidTick = ~(tick_t)0;
+  
+  struct PendingInput {
+    tick_t m_tick = kInvalidTick;
+    Input m_input;
+  };
   
 private:
-  void Step();
+  // moves to the next tick and rewinds the current state to the first tick
+  // that needs simulating, which is returned.
+  tick_t BeginStep();
+  void EndStep(tick_t first_tick);
+  // advances 'state' from tick 'from' to tick 'to' using the recorded inputs.
+  void Simulate(World& state, tick_t from, tick_t to, bool save_checkpoints);
+  // stores the hash and, if due, the checkpoint of the current state at 'tick'.
+  void SaveState(tick_t tick);
+  // copies the closest kept state at or before 'tick' into 'state' and returns its tick.
+  tick_t RestoreState(tick_t tick, World& state) const;
+  bool IsInHistory(tick_t tick) const;
+  tick_t GetCheckpointTick(tick_t tick) const { return tick - tick % m_checkpoint_interval; }
+  uint32_t CheckpointIndex(tick_t tick) const;
+  uint32_t InputIndex(tick_t tick) const { return (uint32_t)tick & m_input_mask; }
+  uint32_t Index(tick_t tick) const { return (uint32_t)tick & m_history_mask; }
   
 private:
-  Input m_input[kGameLoopLength];
-  World m_state[kGameLoopLength];
+  uint32_t m_history_length;
+  // sizes of the input and the per tick rings minus one, both powers of two.
+  // checkpoints are whole worlds and not rounded up.
+  uint32_t m_history_mask;
+  uint32_t m_input_mask;
+  std::vector<Input> m_input;
+  std::vector<PendingInput> m_pending_input;
+  std::vector<uint64_t> m_state_hash;
+  World m_current_state;
+  World m_previous_state;
+  std::vector<World> m_checkpoints;
+  std::vector<tick_t> m_checkpoint_tick;
+  uint32_t m_checkpoint_interval;
   tick_t m_current_tick;
-  float m_tick_time;
-  float m_tick_countdown;
+  // tick the game started or was last reset at, there is no history before it.
+  tick_t m_first_tick;
+  // state given to Reset(), rollbacks to ticks before the first checkpoint
+  // after 'm_first_tick' restart from it.
+  World m_reset_state;
+  // earliest tick whose input was written since the last Step().
+  // states after it are stale and get resimulated.
+  tick_t m_dirty_tick;
+  // last state given to SetState(), rollbacks restart from it when it is closer than a checkpoint.
+  World m_authority_state;
+  tick_t m_authority_tick;
+  StepStats m_step_stats;
+  // inline, games are only moved or copied while no thread steps them.
+  GameMetrics m_metrics;
+  HistoryStats m_history_stats;
+  JobSystem* m_jobs;
+  bool m_keep_previous_state;
+  TickScheduler m_scheduler;
 };
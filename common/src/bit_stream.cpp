@@ -0,0 +1,127 @@
+#include "common/bit_stream.h"
+#include <assert.h>
+
+BitWriter::BitWriter()
+: m_scratch(0)
+, m_scratch_bits(0)
+, m_num_bits(0) {
+}
+
+void BitWriter::FlushWord() {
+  const size_t size = m_data.size();
+  m_data.resize(size + 4);
+  uint8_t* bytes = &m_data[size];
+  bytes[0] = (uint8_t)m_scratch;
+  bytes[1] = (uint8_t)(m_scratch >> 8);
+  bytes[2] = (uint8_t)(m_scratch >> 16);
+  bytes[3] = (uint8_t)(m_scratch >> 24);
+  m_scratch >>= 32;
+  m_scratch_bits -= 32;
+}
+
+void BitWriter::WriteVar(uint64_t value, uint32_t group_bits) {
+  assert(group_bits > 0 && group_bits < 32);
+  const uint64_t group_mask = (1ull << group_bits) - 1;
+  // the continue bit goes right after its group. groups are gathered and
+  // written as few words as fit.
+  uint64_t packed = 0;
+  uint32_t num_bits = 0;
+  for(;;) {
+    const uint64_t group = value & group_mask;
+    value >>= group_bits;
+    packed |= (group | (value != 0 ? 1ull << group_bits : 0)) << num_bits;
+    num_bits += group_bits + 1;
+    if(value == 0) {
+      break;
+    }
+    if(num_bits + group_bits + 1 > 32) {
+      Write((uint32_t)packed, num_bits);
+      packed = 0;
+      num_bits = 0;
+    }
+  }
+  Write((uint32_t)packed, num_bits);
+}
+
+void BitWriter::WriteSignedVar(int64_t value, uint32_t group_bits) {
+  WriteVar(((uint64_t)value << 1) ^ (uint64_t)(value >> 63), group_bits);
+}
+
+void BitWriter::Flush() {
+  while(m_scratch_bits > 0) {
+    const uint32_t num_bits = m_scratch_bits < 8 ? m_scratch_bits : 8;
+    m_num_bits += 8 - num_bits;
+    m_data.push_back((uint8_t)m_scratch);
+    m_scratch >>= 8;
+    m_scratch_bits -= num_bits;
+  }
+}
+
+void BitWriter::Clear() {
+  m_data.clear();
+  m_scratch = 0;
+  m_scratch_bits = 0;
+  m_num_bits = 0;
+}
+
+BitReader::BitReader(const uint8_t* data, size_t size)
+: m_data(data)
+, m_size(size)
+, m_bit(0) {
+}
+
+bool BitReader::Read(uint32_t& value, uint32_t num_bits) {
+  assert(num_bits <= 32);
+  if(num_bits > GetNumBitsLeft()) {
+    return false;
+  }
+  
+  const size_t first_byte = m_bit / 8;
+  const uint32_t shift = (uint32_t)(m_bit % 8);
+  const uint32_t num_bytes = (shift + num_bits + 7) / 8;
+  uint64_t bits = 0;
+  for(uint32_t i = 0; i < num_bytes; ++i) {
+    bits |= (uint64_t)m_data[first_byte + i] << (8 * i);
+  }
+  
+  const uint64_t mask = (1ull << num_bits) - 1;
+  value = (uint32_t)((bits >> shift) & mask);
+  m_bit += num_bits;
+  return true;
+}
+
+bool BitReader::ReadBool(bool& value) {
+  uint32_t bit;
+  if(!Read(bit, 1)) {
+    return false;
+  }
+  value = bit != 0;
+  return true;
+}
+
+bool BitReader::ReadVar(uint64_t& value, uint32_t group_bits) {
+  assert(group_bits > 0 && group_bits < 32);
+  value = 0;
+  for(uint32_t shift = 0; shift < 64; shift += group_bits) {
+    uint32_t group;
+    bool more;
+    if(!Read(group, group_bits) || !ReadBool(more)) {
+      return false;
+    }
+    value |= (uint64_t)group << shift;
+    if(!more) {
+      return true;
+    }
+  }
+  // longer than any value a writer produces.
+  return false;
+}
+
+bool BitReader::ReadSignedVar(int64_t& value, uint32_t group_bits) {
+  uint64_t zigzag;
+  if(!ReadVar(zigzag, group_bits)) {
+    return false;
+  }
+  value = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+  return true;
+}
@@ -0,0 +1,277 @@
+#include "common/bvh.h"
+#include <algorithm>
+#include <math.h>
+
+const uint32_t Bvh::kMaxDepth;
+
+static float get_axis(const vec3& v, uint32_t axis) {
+  return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
+// entry distance of the ray into the bounds, false if it misses them before 'max_distance'.
+static bool intersect_bounds(const float* min, const float* max, const float* origin, const float* inv_direction, float max_distance, float& distance) {
+  float t_min = 0.f, t_max = max_distance;
+  for(uint32_t axis = 0; axis < 3; ++axis) {
+    float t0 = (min[axis] - origin[axis]) * inv_direction[axis];
+    float t1 = (max[axis] - origin[axis]) * inv_direction[axis];
+    if(t0 > t1) {
+      std::swap(t0, t1);
+    }
+    t_min = t0 > t_min ? t0 : t_min;
+    t_max = t1 < t_max ? t1 : t_max;
+  }
+  distance = t_min;
+  return t_min <= t_max;
+}
+
+static bool overlap_bounds(const float* min, const float* max, const Aabb& region) {
+  return min[0] <= region.m_max.x && region.m_min.x <= max[0]
+    && min[1] <= region.m_max.y && region.m_min.y <= max[1]
+    && min[2] <= region.m_max.z && region.m_min.z <= max[2];
+}
+
+static bool overlap_bounds(const Aabb& bounds, const Aabb& region) {
+  return bounds.m_min.x <= region.m_max.x && region.m_min.x <= bounds.m_max.x
+    && bounds.m_min.y <= region.m_max.y && region.m_min.y <= bounds.m_max.y
+    && bounds.m_min.z <= region.m_max.z && region.m_min.z <= bounds.m_max.z;
+}
+
+Bvh::Bvh(const BvhConfig& config)
+: m_config(config)
+, m_build_area(0.f) {
+  if(m_config.m_leaf_size == 0) {
+    m_config.m_leaf_size = 1;
+  }
+}
+
+void Bvh::Build(const World& world) {
+  const uint32_t num_entities = world.GetNumEntities();
+  m_items.resize(num_entities);
+  for(uint32_t i = 0; i < num_entities; ++i) {
+    Item& item = m_items[i];
+    item.m_box = get_cube_box(world, i);
+    item.m_bounds = get_cube_bounds(item.m_box);
+    item.m_entity = world.GetEntity(i);
+    item.m_index = i;
+  }
+  
+  m_nodes.clear();
+  m_nodes.reserve(num_entities / m_config.m_leaf_size * 2 + 1);
+  if(num_entities > 0) {
+    BuildNode(0, num_entities, 0);
+  }
+  m_build_area = Refit();
+  
+  m_stats.m_num_builds += 1;
+  m_stats.m_num_nodes = (uint32_t)m_nodes.size();
+  m_stats.m_quality = 1.f;
+}
+
+void Bvh::Update(const World& world) {
+  const uint32_t num_entities = world.GetNumEntities();
+  if(num_entities != m_items.size() || m_nodes.empty()) {
+    Build(world);
+    return;
+  }
+  for(Item& item : m_items) {
+    if(world.GetEntity(item.m_index) != item.m_entity) {
+      Build(world);
+      return;
+    }
+    item.m_box = get_cube_box(world, item.m_index);
+    item.m_bounds = get_cube_bounds(item.m_box);
+  }
+  
+  const float area = Refit();
+  m_stats.m_num_refits += 1;
+  m_stats.m_quality = m_build_area > 0.f ? area / m_build_area : 1.f;
+  if(m_stats.m_quality > m_config.m_rebuild_ratio) {
+    Build(world);
+  }
+}
+
+void Bvh::BuildNode(uint32_t first, uint32_t count, uint32_t depth) {
+  const uint32_t index = (uint32_t)m_nodes.size();
+  m_nodes.push_back(Node());
+  m_nodes[index].m_first = first;
+  m_nodes[index].m_count = count;
+  if(count <= m_config.m_leaf_size || depth + 1 >= kMaxDepth) {
+    return;
+  }
+  
+  // splits the longest axis of the centers at the median.
+  vec3 min = m_items[first].m_box.m_center, max = min;
+  for(uint32_t i = first + 1; i < first + count; ++i) {
+    const vec3& center = m_items[i].m_box.m_center;
+    min = vec3(fminf(min.x, center.x), fminf(min.y, center.y), fminf(min.z, center.z));
+    max = vec3(fmaxf(max.x, center.x), fmaxf(max.y, center.y), fmaxf(max.z, center.z));
+  }
+  const vec3 size = max - min;
+  const uint32_t axis = size.x >= size.y && size.x >= size.z ? 0 : (size.y >= size.z ? 1 : 2);
+  const uint32_t half = count / 2;
+  std::nth_element(m_items.begin() + first, m_items.begin() + first + half, m_items.begin() + first + count,
+                   [axis](const Item& a, const Item& b) {
+    return get_axis(a.m_box.m_center, axis) < get_axis(b.m_box.m_center, axis);
+  });
+  
+  BuildNode(first, half, depth + 1);
+  const uint32_t second = (uint32_t)m_nodes.size();
+  BuildNode(first + half, count - half, depth + 1);
+  m_nodes[index].m_first = second;
+  m_nodes[index].m_count = 0;
+}
+
+float Bvh::Refit() {
+  float area = 0.f;
+  for(uint32_t n = (uint32_t)m_nodes.size(); n > 0; --n) {
+    Node& node = m_nodes[n - 1];
+    vec3 min, max;
+    if(node.m_count > 0) {
+      min = m_items[node.m_first].m_bounds.m_min;
+      max = m_items[node.m_first].m_bounds.m_max;
+      for(uint32_t i = node.m_first + 1; i < node.m_first + node.m_count; ++i) {
+        const Aabb& bounds = m_items[i].m_bounds;
+        min = vec3(fminf(min.x, bounds.m_min.x), fminf(min.y, bounds.m_min.y), fminf(min.z, bounds.m_min.z));
+        max = vec3(fmaxf(max.x, bounds.m_max.x), fmaxf(max.y, bounds.m_max.y), fmaxf(max.z, bounds.m_max.z));
+      }
+    } else {
+      // children come later in the array and are already fitted.
+      const Node& a = m_nodes[n];
+      const Node& b = m_nodes[node.m_first];
+      min = vec3(fminf(a.m_min[0], b.m_min[0]), fminf(a.m_min[1], b.m_min[1]), fminf(a.m_min[2], b.m_min[2]));
+      max = vec3(fmaxf(a.m_max[0], b.m_max[0]), fmaxf(a.m_max[1], b.m_max[1]), fmaxf(a.m_max[2], b.m_max[2]));
+    }
+    node.m_min[0] = min.x;
+    node.m_min[1] = min.y;
+    node.m_min[2] = min.z;
+    node.m_max[0] = max.x;
+    node.m_max[1] = max.y;
+    node.m_max[2] = max.z;
+    const vec3 size = max - min;
+    area += 2.f * (size.x * size.y + size.y * size.z + size.z * size.x);
+  }
+  return area;
+}
+
+bool Bvh::Raycast(const Ray& ray, RayHit& hit) const {
+  if(m_nodes.empty()) {
+    return false;
+  }
+  
+  const float origin[3] = { ray.m_origin.x, ray.m_origin.y, ray.m_origin.z };
+  float inv_direction[3];
+  for(uint32_t axis = 0; axis < 3; ++axis) {
+    const float d = get_axis(ray.m_direction, axis);
+    inv_direction[axis] = fabsf(d) > 1e-12f ? 1.f / d : (d < 0.f ? -1e30f : 1e30f);
+  }
+  
+  // nearest child first, nodes entered behind the best hit are skipped.
+  struct StackEntry {
+    uint32_t m_node;
+    float m_distance;
+  };
+  StackEntry stack[kMaxDepth * 2];
+  uint32_t size = 0;
+  float best = ray.m_max_distance;
+  bool found = false;
+  float distance;
+  if(intersect_bounds(m_nodes[0].m_min, m_nodes[0].m_max, origin, inv_direction, best, distance)) {
+    stack[size++] = { 0, distance };
+  }
+  while(size > 0) {
+    const StackEntry entry = stack[--size];
+    if(entry.m_distance > best) {
+      continue;
+    }
+    const Node& node = m_nodes[entry.m_node];
+    if(node.m_count > 0) {
+      for(uint32_t i = node.m_first; i < node.m_first + node.m_count; ++i) {
+        const Item& item = m_items[i];
+        if(!intersect_ray(item.m_box, ray.m_origin, ray.m_direction, best, distance)) {
+          continue;
+        }
+        if(!found || distance < best || (distance == best && item.m_entity < hit.m_entity)) {
+          hit.m_entity = item.m_entity;
+          hit.m_distance = distance;
+          best = distance;
+          found = true;
+        }
+      }
+      continue;
+    }
+    
+    const uint32_t children[2] = { entry.m_node + 1, node.m_first };
+    float distances[2];
+    bool hits[2];
+    for(uint32_t c = 0; c < 2; ++c) {
+      const Node& child = m_nodes[children[c]];
+      hits[c] = intersect_bounds(child.m_min, child.m_max, origin, inv_direction, best, distances[c]);
+    }
+    const uint32_t near = distances[1] < distances[0] ? 1 : 0;
+    if(hits[1 - near]) {
+      stack[size++] = { children[1 - near], distances[1 - near] };
+    }
+    if(hits[near]) {
+      stack[size++] = { children[near], distances[near] };
+    }
+  }
+  if(found) {
+    hit.m_point = ray.m_origin + ray.m_direction * hit.m_distance;
+  }
+  return found;
+}
+
+void Bvh::Raycast(const Ray* rays, uint32_t count, std::vector<RayBatchHit>& hits) const {
+  hits.clear();
+  RayBatchHit batch_hit;
+  for(uint32_t r = 0; r < count; ++r) {
+    if(Raycast(rays[r], batch_hit.m_hit)) {
+      batch_hit.m_ray = r;
+      hits.push_back(batch_hit);
+    }
+  }
+}
+
+template<typename Func>
+void Bvh::ForEachOverlap(const Aabb& region, Func func) const {
+  if(m_nodes.empty()) {
+    return;
+  }
+  
+  uint32_t stack[kMaxDepth * 2];
+  uint32_t size = 0;
+  stack[size++] = 0;
+  while(size > 0) {
+    const uint32_t index = stack[--size];
+    const Node& node = m_nodes[index];
+    if(!overlap_bounds(node.m_min, node.m_max, region)) {
+      continue;
+    }
+    if(node.m_count == 0) {
+      stack[size++] = node.m_first;
+      stack[size++] = index + 1;
+      continue;
+    }
+    for(uint32_t i = node.m_first; i < node.m_first + node.m_count; ++i) {
+      const Item& item = m_items[i];
+      if(overlap_bounds(item.m_bounds, region) && overlap_region(region, item.m_box)) {
+        func(item.m_entity);
+      }
+    }
+  }
+}
+
+void Bvh::Query(const Aabb& region, std::vector<entity_t>& entities) const {
+  entities.clear();
+  ForEachOverlap(region, [&entities](entity_t entity) { entities.push_back(entity); });
+}
+
+void Bvh::Query(const Aabb* regions, uint32_t count, std::vector<RegionBatchHit>& hits) const {
+  hits.clear();
+  for(uint32_t r = 0; r < count; ++r) {
+    ForEachOverlap(regions[r], [&hits, r](entity_t entity) {
+      const RegionBatchHit batch_hit = { r, entity };
+      hits.push_back(batch_hit);
+    });
+  }
+}
@@ -0,0 +1,367 @@
+#include "common/collision.h"
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+
+// cube vertices span [-1, 1] before scaling.
+static const float kCubeHalfExtent = 1.f;
+
+CubeBox get_cube_box(const World& world, uint32_t index) {
+  const EntityChunk& chunk = world.GetChunk(index / EntityChunk::kSize);
+  const uint32_t lane = index % EntityChunk::kSize;
+  CubeBox box;
+  box.m_center = vec3(to_float(chunk.m_position_x[lane]),
+                      to_float(chunk.m_position_y[lane]),
+                      to_float(chunk.m_position_z[lane]));
+  box.m_half_extent = world.GetScale()[index] * kCubeHalfExtent;
+  box.m_rotation = to_float(chunk.m_rotation[lane]);
+  return box;
+}
+
+Aabb get_cube_bounds(const CubeBox& box) {
+  const float extent = box.m_half_extent * (fabsf(cosf(box.m_rotation)) + fabsf(sinf(box.m_rotation)));
+  Aabb bounds;
+  bounds.m_min = vec3(box.m_center.x - extent, box.m_center.y - box.m_half_extent, box.m_center.z - extent);
+  bounds.m_max = vec3(box.m_center.x + extent, box.m_center.y + box.m_half_extent, box.m_center.z + extent);
+  return bounds;
+}
+
+bool overlap_aabb(const CubeBox& a, const CubeBox& b) {
+  const float extent = (a.m_half_extent + b.m_half_extent) * kRotatedExtent;
+  return fabsf(a.m_center.x - b.m_center.x) <= extent
+    && fabsf(a.m_center.z - b.m_center.z) <= extent
+    && fabsf(a.m_center.y - b.m_center.y) <= a.m_half_extent + b.m_half_extent;
+}
+
+bool overlap_obb(const CubeBox& a, const CubeBox& b) {
+  if(fabsf(a.m_center.y - b.m_center.y) > a.m_half_extent + b.m_half_extent) {
+    return false;
+  }
+  
+  // local x and z axes of both boxes on the ground plane.
+  const float cos_a = cosf(a.m_rotation), sin_a = sinf(a.m_rotation);
+  const float cos_b = cosf(b.m_rotation), sin_b = sinf(b.m_rotation);
+  const float axes[4][2] = {
+    { cos_a, -sin_a }, { sin_a, cos_a },
+    { cos_b, -sin_b }, { sin_b, cos_b },
+  };
+  const float dx = b.m_center.x - a.m_center.x;
+  const float dz = b.m_center.z - a.m_center.z;
+  
+  for(uint32_t i = 0; i < 4; ++i) {
+    const float ux = axes[i][0], uz = axes[i][1];
+    const float radius_a = a.m_half_extent * (fabsf(ux * axes[0][0] + uz * axes[0][1]) + fabsf(ux * axes[1][0] + uz * axes[1][1]));
+    const float radius_b = b.m_half_extent * (fabsf(ux * axes[2][0] + uz * axes[2][1]) + fabsf(ux * axes[3][0] + uz * axes[3][1]));
+    if(fabsf(ux * dx + uz * dz) > radius_a + radius_b) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool overlap_region(const Aabb& region, const CubeBox& box) {
+  if(box.m_center.y - box.m_half_extent > region.m_max.y || box.m_center.y + box.m_half_extent < region.m_min.y) {
+    return false;
+  }
+  
+  // world x and z, then the local axes of the cube.
+  const float cos_r = cosf(box.m_rotation), sin_r = sinf(box.m_rotation);
+  const float half_x = (region.m_max.x - region.m_min.x) * 0.5f;
+  const float half_z = (region.m_max.z - region.m_min.z) * 0.5f;
+  const float dx = box.m_center.x - (region.m_min.x + half_x);
+  const float dz = box.m_center.z - (region.m_min.z + half_z);
+  const float extent = box.m_half_extent * (fabsf(cos_r) + fabsf(sin_r));
+  if(fabsf(dx) > half_x + extent || fabsf(dz) > half_z + extent) {
+    return false;
+  }
+  const float axes[2][2] = { { cos_r, -sin_r }, { sin_r, cos_r } };
+  for(uint32_t i = 0; i < 2; ++i) {
+    const float ux = axes[i][0], uz = axes[i][1];
+    if(fabsf(ux * dx + uz * dz) > box.m_half_extent + half_x * fabsf(ux) + half_z * fabsf(uz)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// slab test in the frame of the box, local axes as in overlap_obb().
+bool intersect_ray(const CubeBox& box, const vec3& origin, const vec3& direction, float max_distance, float& distance) {
+  const float cos_r = cosf(box.m_rotation), sin_r = sinf(box.m_rotation);
+  const float offset_x = origin.x - box.m_center.x;
+  const float offset_z = origin.z - box.m_center.z;
+  const float local_origin[3] = {
+    offset_x * cos_r - offset_z * sin_r,
+    origin.y - box.m_center.y,
+    offset_x * sin_r + offset_z * cos_r,
+  };
+  const float local_direction[3] = {
+    direction.x * cos_r - direction.z * sin_r,
+    direction.y,
+    direction.x * sin_r + direction.z * cos_r,
+  };
+  
+  float t_min = 0.f, t_max = max_distance;
+  for(uint32_t axis = 0; axis < 3; ++axis) {
+    const float o = local_origin[axis], d = local_direction[axis];
+    if(fabsf(d) < 1e-12f) {
+      if(fabsf(o) > box.m_half_extent) {
+        return false;
+      }
+      continue;
+    }
+    float t0 = (-box.m_half_extent - o) / d;
+    float t1 = (box.m_half_extent - o) / d;
+    if(t0 > t1) {
+      std::swap(t0, t1);
+    }
+    t_min = t0 > t_min ? t0 : t_min;
+    t_max = t1 < t_max ? t1 : t_max;
+    if(t_min > t_max) {
+      return false;
+    }
+  }
+  distance = t_min;
+  return true;
+}
+
+SpatialGrid::SpatialGrid(float cell_size)
+: m_cell_size(cell_size > 0.f ? cell_size : 1.f)
+, m_inv_cell_size(1.f / m_cell_size)
+, m_bucket_mask(0) {
+}
+
+int32_t SpatialGrid::ToCell(float value) const {
+  return (int32_t)floorf(value * m_inv_cell_size);
+}
+
+uint32_t SpatialGrid::Bucket(int32_t x, int32_t z) const {
+  return ((uint32_t)x * 73856093u ^ (uint32_t)z * 19349663u) & m_bucket_mask;
+}
+
+bool SpatialGrid::Overlap(const Bounds& a, const Bounds& b) {
+  return a.m_min_x <= b.m_max_x && b.m_min_x <= a.m_max_x
+    && a.m_min_z <= b.m_max_z && b.m_min_z <= a.m_max_z;
+}
+
+void SpatialGrid::Build(const World& world) {
+  const uint32_t num_entities = world.GetNumEntities();
+  const float* scale = world.GetScale();
+  m_bounds.resize(num_entities);
+  
+  for(uint32_t c = 0; c < world.GetNumChunks(); ++c) {
+    const EntityChunk& chunk = world.GetChunk(c);
+    const uint32_t first = c * EntityChunk::kSize;
+    for(uint32_t lane = 0; lane < world.GetChunkEntities(c); ++lane) {
+      // rotation independent, saves the trigonometry on every rebuild.
+      const float extent = scale[first + lane] * kCubeHalfExtent * kRotatedExtent;
+      const float x = to_float(chunk.m_position_x[lane]);
+      const float z = to_float(chunk.m_position_z[lane]);
+      Bounds& bounds = m_bounds[first + lane];
+      bounds.m_min_x = x - extent;
+      bounds.m_min_z = z - extent;
+      bounds.m_max_x = x + extent;
+      bounds.m_max_z = z + extent;
+    }
+  }
+  Insert();
+}
+
+void SpatialGrid::Build(const World& world, const World& next) {
+  const uint32_t num_entities = world.GetNumEntities();
+  m_bounds.resize(num_entities);
+  
+  for(uint32_t i = 0; i < num_entities; ++i) {
+    const float extent = world.GetScale()[i] * kCubeHalfExtent * kRotatedExtent;
+    const scalar3 position = world.GetTranslation(i);
+    float min_x = to_float(position.x), max_x = min_x;
+    float min_z = to_float(position.z), max_z = min_z;
+    uint32_t next_index;
+    if(next.FindIndex(world.GetEntity(i), next_index)) {
+      const scalar3 next_position = next.GetTranslation(next_index);
+      min_x = fminf(min_x, to_float(next_position.x));
+      max_x = fmaxf(max_x, to_float(next_position.x));
+      min_z = fminf(min_z, to_float(next_position.z));
+      max_z = fmaxf(max_z, to_float(next_position.z));
+    }
+    Bounds& bounds = m_bounds[i];
+    bounds.m_min_x = min_x - extent;
+    bounds.m_min_z = min_z - extent;
+    bounds.m_max_x = max_x + extent;
+    bounds.m_max_z = max_z + extent;
+  }
+  Insert();
+}
+
+void SpatialGrid::Insert() {
+  const uint32_t num_entities = (uint32_t)m_bounds.size();
+  m_ranges.resize(num_entities);
+  
+  uint32_t num_cells = 0;
+  for(uint32_t i = 0; i < num_entities; ++i) {
+    const Bounds& bounds = m_bounds[i];
+    CellRange& range = m_ranges[i];
+    range.m_min_x = ToCell(bounds.m_min_x);
+    range.m_min_z = ToCell(bounds.m_min_z);
+    range.m_max_x = ToCell(bounds.m_max_x);
+    range.m_max_z = ToCell(bounds.m_max_z);
+    num_cells += (uint32_t)((range.m_max_x - range.m_min_x + 1) * (range.m_max_z - range.m_min_z + 1));
+  }
+  
+  // at most half full, few unrelated cells end up in one bucket.
+  uint32_t num_buckets = 16;
+  while(num_buckets < num_cells * 2) {
+    num_buckets *= 2;
+  }
+  m_bucket_mask = num_buckets - 1;
+  m_bucket_start.assign(num_buckets + 1, 0);
+  m_cells.resize(num_cells);
+  
+  for(const CellRange& range : m_ranges) {
+    for(int32_t z = range.m_min_z; z <= range.m_max_z; ++z) {
+      for(int32_t x = range.m_min_x; x <= range.m_max_x; ++x) {
+        m_bucket_start[Bucket(x, z) + 1] += 1;
+      }
+    }
+  }
+  for(uint32_t b = 0; b < num_buckets; ++b) {
+    m_bucket_start[b + 1] += m_bucket_start[b];
+  }
+  // fills every bucket from its start, leaving the starts one bucket ahead.
+  for(uint32_t i = 0; i < num_entities; ++i) {
+    const CellRange& range = m_ranges[i];
+    for(int32_t z = range.m_min_z; z <= range.m_max_z; ++z) {
+      for(int32_t x = range.m_min_x; x <= range.m_max_x; ++x) {
+        Cell& cell = m_cells[m_bucket_start[Bucket(x, z)]++];
+        cell.m_x = x;
+        cell.m_z = z;
+        cell.m_index = i;
+        cell.m_min_x = range.m_min_x;
+        cell.m_min_z = range.m_min_z;
+        cell.m_bounds = m_bounds[i];
+      }
+    }
+  }
+  for(uint32_t b = num_buckets; b > 0; --b) {
+    m_bucket_start[b] = m_bucket_start[b - 1];
+  }
+  m_bucket_start[0] = 0;
+}
+
+void SpatialGrid::FindPairs(std::vector<EntityPair>& pairs) const {
+  pairs.clear();
+  const uint32_t num_buckets = m_bucket_mask + 1;
+  for(uint32_t b = 0; b < num_buckets; ++b) {
+    const uint32_t end = m_bucket_start[b + 1];
+    for(uint32_t i = m_bucket_start[b]; i < end; ++i) {
+      const Cell& cell = m_cells[i];
+      for(uint32_t j = i + 1; j < end; ++j) {
+        const Cell& other = m_cells[j];
+        if(other.m_x != cell.m_x || other.m_z != cell.m_z || !Overlap(cell.m_bounds, other.m_bounds)) {
+          continue;
+        }
+        // pairs sharing several cells are only reported in the one holding
+        // the min corner of their overlap.
+        const int32_t corner_x = cell.m_min_x > other.m_min_x ? cell.m_min_x : other.m_min_x;
+        const int32_t corner_z = cell.m_min_z > other.m_min_z ? cell.m_min_z : other.m_min_z;
+        if(corner_x != cell.m_x || corner_z != cell.m_z) {
+          continue;
+        }
+        EntityPair pair;
+        pair.m_a = cell.m_index < other.m_index ? cell.m_index : other.m_index;
+        pair.m_b = cell.m_index < other.m_index ? other.m_index : cell.m_index;
+        pairs.push_back(pair);
+      }
+    }
+  }
+}
+
+void SpatialGrid::FindOverlaps(const World& world, std::vector<EntityPair>& pairs) const {
+  FindPairs(pairs);
+  size_t count = 0;
+  for(const EntityPair& pair : pairs) {
+    if(overlap_obb(get_cube_box(world, pair.m_a), get_cube_box(world, pair.m_b))) {
+      pairs[count++] = pair;
+    }
+  }
+  pairs.resize(count);
+}
+
+void SpatialGrid::Query(float min_x, float min_z, float max_x, float max_z, std::vector<uint32_t>& indices) const {
+  indices.clear();
+  if(m_bounds.empty()) {
+    return;
+  }
+  
+  Bounds query;
+  query.m_min_x = min_x;
+  query.m_min_z = min_z;
+  query.m_max_x = max_x;
+  query.m_max_z = max_z;
+  for(int32_t z = ToCell(min_z); z <= ToCell(max_z); ++z) {
+    for(int32_t x = ToCell(min_x); x <= ToCell(max_x); ++x) {
+      const uint32_t bucket = Bucket(x, z);
+      for(uint32_t i = m_bucket_start[bucket]; i < m_bucket_start[bucket + 1]; ++i) {
+        const Cell& cell = m_cells[i];
+        if(cell.m_x != x || cell.m_z != z) {
+          continue;
+        }
+        const Bounds& bounds = cell.m_bounds;
+        if(!Overlap(bounds, query)) {
+          continue;
+        }
+        // same rule as pairs, report in the cell of the overlap's min corner.
+        const float corner_x = bounds.m_min_x > min_x ? bounds.m_min_x : min_x;
+        const float corner_z = bounds.m_min_z > min_z ? bounds.m_min_z : min_z;
+        if(ToCell(corner_x) == x && ToCell(corner_z) == z) {
+          indices.push_back(cell.m_index);
+        }
+      }
+    }
+  }
+}
+
+void SpatialGrid::QueryRay(float x, float z, float dir_x, float dir_z, float length, std::vector<uint32_t>& indices) const {
+  indices.clear();
+  if(m_bounds.empty()) {
+    return;
+  }
+  
+  // walks the cells the segment crosses, one axis step at a time.
+  int32_t cell_x = ToCell(x);
+  int32_t cell_z = ToCell(z);
+  const int32_t end_x = ToCell(x + dir_x * length);
+  const int32_t end_z = ToCell(z + dir_z * length);
+  const int32_t step_x = end_x > cell_x ? 1 : -1;
+  const int32_t step_z = end_z > cell_z ? 1 : -1;
+  const double delta_x = dir_x != 0.f ? m_cell_size / fabs((double)dir_x) : HUGE_VAL;
+  const double delta_z = dir_z != 0.f ? m_cell_size / fabs((double)dir_z) : HUGE_VAL;
+  double next_x = dir_x != 0.f ? ((cell_x + (step_x > 0 ? 1 : 0)) * (double)m_cell_size - x) / dir_x : HUGE_VAL;
+  double next_z = dir_z != 0.f ? ((cell_z + (step_z > 0 ? 1 : 0)) * (double)m_cell_size - z) / dir_z : HUGE_VAL;
+  
+  uint32_t num_steps = (uint32_t)(abs(end_x - cell_x) + abs(end_z - cell_z));
+  for(;;) {
+    const uint32_t bucket = Bucket(cell_x, cell_z);
+    for(uint32_t i = m_bucket_start[bucket]; i < m_bucket_start[bucket + 1]; ++i) {
+      const Cell& cell = m_cells[i];
+      if(cell.m_x == cell_x && cell.m_z == cell_z) {
+        indices.push_back(cell.m_index);
+      }
+    }
+    if(num_steps-- == 0) {
+      break;
+    }
+    // never steps past the end cell on either axis, so the walk ends in it
+    // even if rounding picks the other axis where the segment grazes a corner.
+    if(cell_x == end_x || (cell_z != end_z && next_z < next_x)) {
+      cell_z += step_z;
+      next_z += delta_z;
+    } else {
+      cell_x += step_x;
+      next_x += delta_x;
+    }
+  }
+  
+  // entities spanning several crossed cells show up once per cell.
+  std::sort(indices.begin(), indices.end());
+  indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+}
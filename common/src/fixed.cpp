@@ -0,0 +1,6 @@
+#include "common/fixed.h"
+
+const fixed fixed::kZero = fixed::from_raw(0);
+const fixed fixed::kOne = fixed::from_raw(fixed::kOneRaw);
+
+const fixed3 fixed3::kZero(fixed::kZero, fixed::kZero, fixed::kZero);
@@ -0,0 +1,97 @@
+#include "common/input_packet.h"
+
+// bits per group of the variable length fields.
+static const uint32_t kTickGroupBits = 7;
+static const uint32_t kCountGroupBits = 3;
+
+bool write_input_packet(const InputPacket& packet, BitWriter& writer) {
+  if(packet.m_count == 0 || packet.m_count > kMaxInputWindow || packet.m_count - 1 > packet.m_newest_tick) {
+    return false;
+  }
+  for(uint32_t i = 0; i < packet.m_count; ++i) {
+    if(packet.m_inputs[i].GetButtons() >> kInputButtonBits) {
+      return false;
+    }
+  }
+  
+  writer.WriteVar(packet.m_newest_tick, kTickGroupBits);
+  writer.WriteVar(packet.m_count - 1, kCountGroupBits);
+  
+  uint32_t run_start = 0;
+  for(uint32_t i = 1; i <= packet.m_count; ++i) {
+    if(i < packet.m_count && packet.m_inputs[i] == packet.m_inputs[run_start]) {
+      continue;
+    }
+    writer.Write(packet.m_inputs[run_start].GetButtons(), kInputButtonBits);
+    writer.WriteVar(i - run_start - 1, kCountGroupBits);
+    run_start = i;
+  }
+  return true;
+}
+
+bool read_input_packet(BitReader& reader, InputPacket& packet) {
+  uint64_t newest_tick, count;
+  if(!reader.ReadVar(newest_tick, kTickGroupBits) || !reader.ReadVar(count, kCountGroupBits)) {
+    return false;
+  }
+  count += 1;
+  if(count > kMaxInputWindow || count - 1 > newest_tick) {
+    return false;
+  }
+  
+  uint32_t num_read = 0;
+  while(num_read < count) {
+    uint32_t buttons;
+    uint64_t run_length;
+    if(!reader.Read(buttons, kInputButtonBits) || !reader.ReadVar(run_length, kCountGroupBits)) {
+      return false;
+    }
+    run_length += 1;
+    if(run_length > count - num_read) {
+      return false;
+    }
+    for(uint64_t i = 0; i < run_length; ++i) {
+      packet.m_inputs[num_read++] = Input(buttons);
+    }
+  }
+  
+  packet.m_newest_tick = newest_tick;
+  packet.m_count = (uint32_t)count;
+  return true;
+}
+
+InputWindow::InputWindow(uint32_t length)
+: m_count(0)
+, m_newest_tick(0) {
+  length = length < 1 ? 1 : (length > kMaxInputWindow ? kMaxInputWindow : length);
+  m_inputs.resize(length);
+}
+
+void InputWindow::Push(tick_t tick, const Input& input) {
+  if(m_count == 0 || tick != m_newest_tick + 1) {
+    m_count = 0;
+  }
+  m_newest_tick = tick;
+  m_inputs[tick % m_inputs.size()] = input;
+  const uint32_t length = (uint32_t)m_inputs.size();
+  // never reach before tick 0.
+  const uint32_t max_count = tick + 1 < length ? (uint32_t)tick + 1 : length;
+  m_count = m_count + 1 < max_count ? m_count + 1 : max_count;
+}
+
+bool InputWindow::GetPacket(InputPacket& packet) const {
+  if(m_count == 0) {
+    return false;
+  }
+  packet.m_newest_tick = m_newest_tick;
+  packet.m_count = m_count;
+  for(uint32_t i = 0; i < m_count; ++i) {
+    packet.m_inputs[i] = m_inputs[(m_newest_tick - i) % m_inputs.size()];
+  }
+  return true;
+}
+
+bool InputWindow::Write(BitWriter& writer) const {
+  InputPacket packet;
+  return GetPacket(packet) && write_input_packet(packet, writer);
+}
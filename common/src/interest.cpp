@@ -0,0 +1,127 @@
+#include "common/interest.h"
+#include "common/tick_scheduler.h"
+#include <algorithm>
+#include <math.h>
+
+InterestManager::InterestManager(const InterestConfig& config)
+: m_config(config)
+, m_grid(config.m_cell_size) {
+  if(m_config.m_leave_radius < m_config.m_enter_radius) {
+    m_config.m_leave_radius = m_config.m_enter_radius;
+  }
+}
+
+uint32_t InterestManager::AddClient() {
+  uint32_t client;
+  if(!m_free_clients.empty()) {
+    client = m_free_clients.back();
+    m_free_clients.pop_back();
+  } else {
+    client = (uint32_t)m_clients.size();
+    m_clients.push_back(Client());
+  }
+  m_clients[client] = Client();
+  m_clients[client].m_active = true;
+  m_clients[client].m_interest = std::make_shared<InterestSet>();
+  return client;
+}
+
+void InterestManager::RemoveClient(uint32_t client) {
+  m_clients[client] = Client();
+  m_free_clients.push_back(client);
+}
+
+void InterestManager::SetFocus(uint32_t client, float x, float z) {
+  m_clients[client].m_x = x;
+  m_clients[client].m_z = z;
+}
+
+void InterestManager::Update(const World& world) {
+  const uint64_t start_ns = TickScheduler::NowNs();
+  m_grid.Build(world);
+  
+  // groups of clients whose focus shares a cell as large as the leave radius.
+  const float group_size = m_config.m_leave_radius > 0.f ? m_config.m_leave_radius : 1.f;
+  m_groups.clear();
+  for(uint32_t i = 0; i < m_clients.size(); ++i) {
+    const Client& client = m_clients[i];
+    if(!client.m_active) {
+      continue;
+    }
+    const int32_t x = (int32_t)floorf(client.m_x / group_size);
+    const int32_t z = (int32_t)floorf(client.m_z / group_size);
+    GroupEntry entry;
+    entry.m_key = ((uint64_t)(uint32_t)x << 32) | (uint32_t)z;
+    entry.m_client = i;
+    m_groups.push_back(entry);
+  }
+  std::sort(m_groups.begin(), m_groups.end());
+  
+  m_stats.m_num_clients = (uint32_t)m_groups.size();
+  m_stats.m_num_groups = 0;
+  m_stats.m_num_candidates = 0;
+  m_stats.m_num_relevant = 0;
+  
+  for(size_t begin = 0; begin < m_groups.size();) {
+    size_t end = begin + 1;
+    while(end < m_groups.size() && m_groups[end].m_key == m_groups[begin].m_key) {
+      ++end;
+    }
+    
+    // one query covers the leave radius of every client in the group.
+    const Client& first = m_clients[m_groups[begin].m_client];
+    float min_x = first.m_x, max_x = first.m_x, min_z = first.m_z, max_z = first.m_z;
+    for(size_t i = begin + 1; i < end; ++i) {
+      const Client& client = m_clients[m_groups[i].m_client];
+      min_x = std::min(min_x, client.m_x);
+      max_x = std::max(max_x, client.m_x);
+      min_z = std::min(min_z, client.m_z);
+      max_z = std::max(max_z, client.m_z);
+    }
+    const float radius = m_config.m_leave_radius;
+    m_grid.Query(min_x - radius, min_z - radius, max_x + radius, max_z + radius, m_indices);
+    m_stats.m_num_groups += 1;
+    
+    m_candidates.resize(m_indices.size());
+    for(size_t i = 0; i < m_indices.size(); ++i) {
+      const scalar3 position = world.GetTranslation(m_indices[i]);
+      m_candidates[i].m_x = to_float(position.x);
+      m_candidates[i].m_z = to_float(position.z);
+      m_candidates[i].m_entity = world.GetEntity(m_indices[i]);
+    }
+    
+    for(size_t i = begin; i < end; ++i) {
+      Client& client = m_clients[m_groups[i].m_client];
+      UpdateClient(client);
+      m_stats.m_num_candidates += m_candidates.size();
+      m_stats.m_num_relevant += client.m_interest->size();
+    }
+    begin = end;
+  }
+  m_stats.m_update_ns = TickScheduler::NowNs() - start_ns;
+}
+
+void InterestManager::UpdateClient(Client& client) {
+  const InterestSet& previous = *client.m_interest;
+  const float enter_sq = m_config.m_enter_radius * m_config.m_enter_radius;
+  const float leave_sq = m_config.m_leave_radius * m_config.m_leave_radius;
+  
+  m_scratch.clear();
+  for(const Candidate& candidate : m_candidates) {
+    const float dx = candidate.m_x - client.m_x;
+    const float dz = candidate.m_z - client.m_z;
+    const float distance_sq = dx * dx + dz * dz;
+    if(distance_sq > leave_sq) {
+      continue;
+    }
+    if(distance_sq <= enter_sq || std::binary_search(previous.begin(), previous.end(), candidate.m_entity)) {
+      m_scratch.push_back(candidate.m_entity);
+    }
+  }
+  std::sort(m_scratch.begin(), m_scratch.end());
+  
+  // unchanged sets keep their object, so are shared with earlier snapshots.
+  if(m_scratch != previous) {
+    client.m_interest = std::make_shared<InterestSet>(m_scratch);
+  }
+}
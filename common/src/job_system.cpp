@@ -0,0 +1,139 @@
+#include "common/job_system.h"
+
+JobSystem::JobSystem(uint32_t num_threads)
+: m_wake_generation(0)
+, m_quit(false) {
+  if(num_threads == 0) {
+    num_threads = std::thread::hardware_concurrency();
+  }
+  if(num_threads == 0) {
+    num_threads = 1;
+  }
+  
+  for(uint32_t i = 0; i < num_threads; ++i) {
+    m_queues.push_back(new Queue());
+  }
+  for(uint32_t i = 1; i < num_threads; ++i) {
+    m_threads.push_back(std::thread(&JobSystem::WorkerMain, this, i));
+  }
+}
+
+JobSystem::~JobSystem() {
+  {
+    std::lock_guard<std::mutex> lock(m_wake_mutex);
+    m_quit = true;
+  }
+  m_wake.notify_all();
+  
+  for(std::thread& thread : m_threads) {
+    thread.join();
+  }
+  for(Queue* queue : m_queues) {
+    delete queue;
+  }
+}
+
+void JobSystem::ParallelFor(uint32_t count, uint32_t chunk_size, const RangeFunc& func) {
+  if(count == 0) {
+    return;
+  }
+  if(chunk_size == 0) {
+    chunk_size = 1;
+  }
+  
+  const uint32_t num_chunks = (count + chunk_size - 1) / chunk_size;
+  if(num_chunks == 1 || m_threads.empty()) {
+    func(0, count);
+    return;
+  }
+  
+  // deal contiguous blocks of chunks to each queue, stealing evens out the rest.
+  std::atomic<uint32_t> remaining(num_chunks);
+  const uint32_t num_queues = GetNumThreads();
+  for(uint32_t q = 0; q < num_queues; ++q) {
+    const uint32_t first = (uint32_t)((uint64_t)num_chunks * q / num_queues);
+    const uint32_t last = (uint32_t)((uint64_t)num_chunks * (q + 1) / num_queues);
+    if(first == last) {
+      continue;
+    }
+    
+    Queue& queue = *m_queues[q];
+    std::lock_guard<std::mutex> lock(queue.m_mutex);
+    for(uint32_t c = first; c < last; ++c) {
+      Job job;
+      job.m_func = &func;
+      job.m_begin = c * chunk_size;
+      job.m_end = job.m_begin + chunk_size < count ? job.m_begin + chunk_size : count;
+      job.m_remaining = &remaining;
+      queue.m_jobs.push_back(job);
+    }
+  }
+  
+  {
+    std::lock_guard<std::mutex> lock(m_wake_mutex);
+    ++m_wake_generation;
+  }
+  m_wake.notify_all();
+  
+  // help out until every chunk finished, including the ones stolen from us.
+  Job job;
+  while(remaining.load(std::memory_order_acquire) != 0) {
+    if(FindJob(0, job)) {
+      Run(job);
+    } else {
+      std::this_thread::yield();
+    }
+  }
+}
+
+void JobSystem::WorkerMain(uint32_t index) {
+  uint64_t seen_generation = 0;
+  Job job;
+  for(;;) {
+    if(FindJob(index, job)) {
+      Run(job);
+      continue;
+    }
+    
+    std::unique_lock<std::mutex> lock(m_wake_mutex);
+    m_wake.wait(lock, [&]() { return m_quit || m_wake_generation != seen_generation; });
+    if(m_quit) {
+      return;
+    }
+    seen_generation = m_wake_generation;
+  }
+}
+
+bool JobSystem::Pop(uint32_t index, Job& job) {
+  Queue& queue = *m_queues[index];
+  std::lock_guard<std::mutex> lock(queue.m_mutex);
+  if(queue.m_jobs.empty()) {
+    return false;
+  }
+  job = queue.m_jobs.back();
+  queue.m_jobs.pop_back();
+  return true;
+}
+
+bool JobSystem::Steal(uint32_t index, Job& job) {
+  const uint32_t num_queues = GetNumThreads();
+  for(uint32_t i = 1; i < num_queues; ++i) {
+    Queue& queue = *m_queues[(index + i) % num_queues];
+    std::lock_guard<std::mutex> lock(queue.m_mutex);
+    if(!queue.m_jobs.empty()) {
+      job = queue.m_jobs.front();
+      queue.m_jobs.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+bool JobSystem::FindJob(uint32_t index, Job& job) {
+  return Pop(index, job) || Steal(index, job);
+}
+
+void JobSystem::Run(const Job& job) {
+  (*job.m_func)(job.m_begin, job.m_end);
+  job.m_remaining->fetch_sub(1, std::memory_order_release);
+}
@@ -0,0 +1,167 @@
+#include "common/lag_compensation.h"
+#include <algorithm>
+#include <math.h>
+
+const tick_t LagCompensator::kNoTick;
+const uint32_t LagCompensator::kNoIndex;
+
+static float clamp_alpha(float alpha) {
+  return alpha < 0.f ? 0.f : (alpha > 1.f ? 1.f : alpha);
+}
+
+LagCompensator::LagCompensator(Game& game, uint32_t cache_size, float cell_size)
+: m_game(game)
+, m_entries(cache_size > 0 ? cache_size : 1, Entry(cell_size))
+, m_use_count(0) {
+}
+
+bool LagCompensator::Raycast(tick_t tick, float alpha, const vec3& origin, const vec3& direction, float max_distance, RayHit& hit) {
+  const Entry* entry = Acquire(tick);
+  if(!entry) {
+    return false;
+  }
+  alpha = clamp_alpha(alpha);
+  
+  entry->m_grid.QueryRay(origin.x, origin.z, direction.x, direction.z, max_distance, m_indices);
+  m_stats.m_num_candidates += m_indices.size();
+  
+  bool found = false;
+  for(uint32_t index : m_indices) {
+    float distance;
+    if(!intersect_ray(InterpolateBox(*entry, index, alpha), origin, direction, max_distance, distance)) {
+      continue;
+    }
+    // ties go to the lower id, results do not depend on the grid order.
+    const entity_t entity = entry->m_state.GetEntity(index);
+    if(!found || distance < hit.m_distance || (distance == hit.m_distance && entity < hit.m_entity)) {
+      hit.m_entity = entity;
+      hit.m_distance = distance;
+      found = true;
+    }
+  }
+  if(found) {
+    hit.m_point = origin + direction * hit.m_distance;
+  }
+  return found;
+}
+
+bool LagCompensator::Overlap(tick_t tick, float alpha, const CubeBox& box, std::vector<entity_t>& entities) {
+  entities.clear();
+  const Entry* entry = Acquire(tick);
+  if(!entry) {
+    return false;
+  }
+  alpha = clamp_alpha(alpha);
+  
+  const float extent = box.m_half_extent * kRotatedExtent;
+  entry->m_grid.Query(box.m_center.x - extent, box.m_center.z - extent,
+                      box.m_center.x + extent, box.m_center.z + extent, m_indices);
+  m_stats.m_num_candidates += m_indices.size();
+  
+  for(uint32_t index : m_indices) {
+    if(overlap_obb(box, InterpolateBox(*entry, index, alpha))) {
+      entities.push_back(entry->m_state.GetEntity(index));
+    }
+  }
+  std::sort(entities.begin(), entities.end());
+  return true;
+}
+
+bool LagCompensator::GetBox(tick_t tick, float alpha, entity_t entity, CubeBox& box) {
+  const Entry* entry = Acquire(tick);
+  uint32_t index;
+  if(!entry || !entry->m_state.FindIndex(entity, index)) {
+    return false;
+  }
+  box = InterpolateBox(*entry, index, clamp_alpha(alpha));
+  return true;
+}
+
+void LagCompensator::Clear() {
+  for(Entry& entry : m_entries) {
+    entry.m_tick = kNoTick;
+  }
+}
+
+const LagCompensator::Entry* LagCompensator::Acquire(tick_t tick) {
+  m_stats.m_num_queries += 1;
+  uint64_t hash;
+  if(!m_game.GetStateHash(tick, hash)) {
+    return nullptr;
+  }
+  const bool has_next = tick < m_game.GetCurrentTick();
+  uint64_t next_hash = 0;
+  if(has_next) {
+    m_game.GetStateHash(tick + 1, next_hash);
+  }
+  
+  Entry* oldest = &m_entries[0];
+  for(Entry& entry : m_entries) {
+    if(entry.m_tick == tick && entry.m_hash == hash
+       && entry.m_has_next == has_next && entry.m_next_hash == next_hash) {
+      entry.m_last_used = ++m_use_count;
+      return &entry;
+    }
+    if(entry.m_last_used < oldest->m_last_used) {
+      oldest = &entry;
+    }
+  }
+  
+  // neighbouring ticks are usually cached already, their states are shared
+  // instead of rebuilt from a checkpoint.
+  Entry& entry = *oldest;
+  entry.m_tick = kNoTick;
+  if(!FindCached(tick, hash, entry.m_state)) {
+    m_game.GetState(tick, entry.m_state);
+  }
+  const uint32_t num_entities = entry.m_state.GetNumEntities();
+  entry.m_next_index.assign(num_entities, kNoIndex);
+  if(has_next) {
+    if(!FindCached(tick + 1, next_hash, entry.m_next)) {
+      m_game.GetState(tick + 1, entry.m_next);
+    }
+    for(uint32_t i = 0; i < num_entities; ++i) {
+      entry.m_next.FindIndex(entry.m_state.GetEntity(i), entry.m_next_index[i]);
+    }
+    entry.m_grid.Build(entry.m_state, entry.m_next);
+  } else {
+    entry.m_grid.Build(entry.m_state);
+  }
+  
+  entry.m_tick = tick;
+  entry.m_hash = hash;
+  entry.m_next_hash = next_hash;
+  entry.m_has_next = has_next;
+  entry.m_last_used = ++m_use_count;
+  m_stats.m_num_builds += 1;
+  return &entry;
+}
+
+bool LagCompensator::FindCached(tick_t tick, uint64_t hash, World& state) const {
+  for(const Entry& entry : m_entries) {
+    if(entry.m_tick == kNoTick) {
+      continue;
+    }
+    if(entry.m_tick == tick && entry.m_hash == hash) {
+      state.CopyFrom(entry.m_state);
+      return true;
+    }
+    if(entry.m_has_next && entry.m_tick + 1 == tick && entry.m_next_hash == hash) {
+      state.CopyFrom(entry.m_next);
+      return true;
+    }
+  }
+  return false;
+}
+
+CubeBox LagCompensator::InterpolateBox(const Entry& entry, uint32_t index, float alpha) {
+  CubeBox box = get_cube_box(entry.m_state, index);
+  const uint32_t next_index = entry.m_next_index[index];
+  if(alpha > 0.f && next_index != kNoIndex) {
+    const CubeBox next = get_cube_box(entry.m_next, next_index);
+    box.m_center = vec3::lerp(box.m_center, next.m_center, alpha);
+    box.m_half_extent += (next.m_half_extent - box.m_half_extent) * alpha;
+    box.m_rotation += (next.m_rotation - box.m_rotation) * alpha;
+  }
+  return box;
+}
@@ -0,0 +1,144 @@
+#include "common/metrics.h"
+
+const uint32_t HistogramSnapshot::kNumBuckets;
+
+uint32_t HistogramSnapshot::GetBucket(uint64_t value) {
+  if(value == 0) {
+    return 0;
+  }
+  const uint32_t bucket = 64 - (uint32_t)__builtin_clzll(value);
+  return bucket < kNumBuckets ? bucket : kNumBuckets - 1;
+}
+
+uint64_t HistogramSnapshot::GetBucketLimit(uint32_t bucket) {
+  if(bucket == 0) {
+    return 0;
+  }
+  if(bucket >= kNumBuckets - 1) {
+    return ~(uint64_t)0;
+  }
+  return ((uint64_t)1 << bucket) - 1;
+}
+
+uint64_t HistogramSnapshot::GetCount() const {
+  uint64_t count = 0;
+  for(uint32_t b = 0; b < kNumBuckets; ++b) {
+    count += m_buckets[b];
+  }
+  return count;
+}
+
+double HistogramSnapshot::GetMean() const {
+  const uint64_t count = GetCount();
+  return count > 0 ? (double)m_sum / (double)count : 0.0;
+}
+
+uint64_t HistogramSnapshot::GetQuantile(double q) const {
+  const uint64_t count = GetCount();
+  if(count == 0) {
+    return 0;
+  }
+  q = q < 0.0 ? 0.0 : (q > 1.0 ? 1.0 : q);
+  uint64_t rank = (uint64_t)(q * (double)count + 0.5);
+  rank = rank < 1 ? 1 : rank;
+  uint64_t seen = 0;
+  for(uint32_t b = 0; b < kNumBuckets; ++b) {
+    seen += m_buckets[b];
+    if(seen >= rank) {
+      const uint64_t limit = GetBucketLimit(b);
+      return limit < m_max ? limit : m_max;
+    }
+  }
+  return m_max;
+}
+
+void HistogramSnapshot::Add(const HistogramSnapshot& other) {
+  for(uint32_t b = 0; b < kNumBuckets; ++b) {
+    m_buckets[b] += other.m_buckets[b];
+  }
+  m_sum += other.m_sum;
+  m_max = other.m_max > m_max ? other.m_max : m_max;
+}
+
+Histogram::Histogram()
+: m_sum(0)
+, m_max(0) {
+  for(std::atomic<uint64_t>& bucket : m_buckets) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+}
+
+Histogram::Histogram(const Histogram& other) noexcept {
+  *this = other;
+}
+
+Histogram& Histogram::operator=(const Histogram& other) noexcept {
+  for(uint32_t b = 0; b < HistogramSnapshot::kNumBuckets; ++b) {
+    m_buckets[b].store(other.m_buckets[b].load(std::memory_order_relaxed), std::memory_order_relaxed);
+  }
+  m_sum.store(other.m_sum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  m_max.store(other.m_max.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  return *this;
+}
+
+void Histogram::Record(uint64_t value) {
+  add_relaxed(m_buckets[HistogramSnapshot::GetBucket(value)], (uint64_t)1);
+  add_relaxed(m_sum, value);
+  if(value > m_max.load(std::memory_order_relaxed)) {
+    m_max.store(value, std::memory_order_relaxed);
+  }
+}
+
+void Histogram::GetSnapshot(HistogramSnapshot& snapshot) const {
+  for(uint32_t b = 0; b < HistogramSnapshot::kNumBuckets; ++b) {
+    snapshot.m_buckets[b] = m_buckets[b].load(std::memory_order_relaxed);
+  }
+  snapshot.m_sum = m_sum.load(std::memory_order_relaxed);
+  snapshot.m_max = m_max.load(std::memory_order_relaxed);
+}
+
+void GameMetricsSnapshot::Add(const GameMetricsSnapshot& other) {
+  m_step_ns.Add(other.m_step_ns);
+  m_resimulated.Add(other.m_resimulated);
+  m_ticks_due.Add(other.m_ticks_due);
+  m_input_lateness.Add(other.m_input_lateness);
+  m_num_rejected_inputs += other.m_num_rejected_inputs;
+}
+
+GameMetrics::GameMetrics()
+: m_num_rejected_inputs(0) {
+}
+
+GameMetrics::GameMetrics(const GameMetrics& other) noexcept
+: m_step_ns(other.m_step_ns)
+, m_resimulated(other.m_resimulated)
+, m_ticks_due(other.m_ticks_due)
+, m_input_lateness(other.m_input_lateness)
+, m_num_rejected_inputs(other.m_num_rejected_inputs.load(std::memory_order_relaxed)) {
+}
+
+GameMetrics& GameMetrics::operator=(const GameMetrics& other) noexcept {
+  m_step_ns = other.m_step_ns;
+  m_resimulated = other.m_resimulated;
+  m_ticks_due = other.m_ticks_due;
+  m_input_lateness = other.m_input_lateness;
+  m_num_rejected_inputs.store(other.m_num_rejected_inputs.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  return *this;
+}
+
+void GameMetrics::RecordStep(uint64_t duration_ns, uint32_t resimulated) {
+  m_step_ns.Record(duration_ns);
+  m_resimulated.Record(resimulated);
+}
+
+void GameMetrics::RecordRejectedInput() {
+  add_relaxed(m_num_rejected_inputs, (uint64_t)1);
+}
+
+void GameMetrics::GetSnapshot(GameMetricsSnapshot& snapshot) const {
+  m_step_ns.GetSnapshot(snapshot.m_step_ns);
+  m_resimulated.GetSnapshot(snapshot.m_resimulated);
+  m_ticks_due.GetSnapshot(snapshot.m_ticks_due);
+  m_input_lateness.GetSnapshot(snapshot.m_input_lateness);
+  snapshot.m_num_rejected_inputs = m_num_rejected_inputs.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,213 @@
+#include "common/movement.h"
+#include "common/input.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SERVSIM_X86 1
+#include <immintrin.h>
+#endif
+
+// function static, so games created during static init already see it.
+static scalar_t get_move_delta() {
+  static const scalar_t delta = to_scalar(0.1f);
+  return delta;
+}
+
+static const uint32_t kLeftBit = 1u << (uint32_t)Input::Key::kLeft;
+static const uint32_t kRightBit = 1u << (uint32_t)Input::Key::kRight;
+static const uint32_t kForwardBit = 1u << (uint32_t)Input::Key::kForward;
+static const uint32_t kBackBit = 1u << (uint32_t)Input::Key::kBack;
+static const uint32_t kMoveBits = kLeftBit | kRightBit | kForwardBit | kBackBit;
+
+// keys are exclusive, in order of priority: left, right, forward, back.
+static void move_scalar(scalar_t* x, scalar_t* z, const uint32_t* masks, uint32_t buttons, uint32_t count) {
+  const scalar_t delta = get_move_delta();
+  for(uint32_t i = 0; i < count; ++i) {
+    const uint32_t lane = buttons & masks[i];
+    if(lane & kLeftBit) {
+      x[i] -= delta;
+    } else if(lane & kRightBit) {
+      x[i] += delta;
+    } else if(lane & kForwardBit) {
+      z[i] -= delta;
+    } else if(lane & kBackBit) {
+      z[i] += delta;
+    }
+  }
+}
+
+#ifdef SERVSIM_X86
+
+// lanes hold the raw 32 bits of a scalar_t, only the add depends on its type.
+static inline __m128i add_lanes(__m128i a, __m128i b) {
+#if SERVSIM_FIXED_POINT
+  return _mm_add_epi32(a, b);
+#else
+  return _mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b)));
+#endif
+}
+
+__attribute__((target("avx2")))
+static inline __m256i add_lanes(__m256i a, __m256i b) {
+#if SERVSIM_FIXED_POINT
+  return _mm256_add_epi32(a, b);
+#else
+  return _mm256_castps_si256(_mm256_add_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b)));
+#endif
+}
+
+static inline __m128i select_lanes(__m128i mask, __m128i a, __m128i b) {
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static void move_sse2(scalar_t* x, scalar_t* z, const uint32_t* masks, uint32_t buttons, uint32_t count) {
+  const scalar_t positive_delta = get_move_delta();
+  const scalar_t negative_delta = -positive_delta;
+  int32_t positive_bits, negative_bits;
+  memcpy(&positive_bits, &positive_delta, sizeof(int32_t));
+  memcpy(&negative_bits, &negative_delta, sizeof(int32_t));
+  
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i all = _mm_set1_epi32(-1);
+  const __m128i input = _mm_set1_epi32((int)buttons);
+  const __m128i left_bit = _mm_set1_epi32((int)kLeftBit);
+  const __m128i right_bit = _mm_set1_epi32((int)kRightBit);
+  const __m128i forward_bit = _mm_set1_epi32((int)kForwardBit);
+  const __m128i back_bit = _mm_set1_epi32((int)kBackBit);
+  const __m128i positive = _mm_set1_epi32(positive_bits);
+  const __m128i negative = _mm_set1_epi32(negative_bits);
+  
+  uint32_t i = 0;
+  for(; i + 4 <= count; i += 4) {
+    const __m128i lane = _mm_and_si128(input, _mm_loadu_si128((const __m128i*)(masks + i)));
+    const __m128i left = _mm_xor_si128(_mm_cmpeq_epi32(_mm_and_si128(lane, left_bit), zero), all);
+    const __m128i right = _mm_xor_si128(_mm_cmpeq_epi32(_mm_and_si128(lane, right_bit), zero), all);
+    const __m128i forward = _mm_xor_si128(_mm_cmpeq_epi32(_mm_and_si128(lane, forward_bit), zero), all);
+    const __m128i back = _mm_xor_si128(_mm_cmpeq_epi32(_mm_and_si128(lane, back_bit), zero), all);
+    
+    const __m128i move_x = _mm_or_si128(left, right);
+    const __m128i move_z = _mm_andnot_si128(move_x, _mm_or_si128(forward, back));
+    const __m128i dx = select_lanes(left, negative, positive);
+    const __m128i dz = select_lanes(forward, negative, positive);
+    
+    // blend instead of adding zero, so untouched lanes keep -0.f as is.
+    const __m128i px = _mm_loadu_si128((const __m128i*)(x + i));
+    const __m128i pz = _mm_loadu_si128((const __m128i*)(z + i));
+    _mm_storeu_si128((__m128i*)(x + i), select_lanes(move_x, add_lanes(px, dx), px));
+    _mm_storeu_si128((__m128i*)(z + i), select_lanes(move_z, add_lanes(pz, dz), pz));
+  }
+  move_scalar(x + i, z + i, masks + i, buttons, count - i);
+}
+
+__attribute__((target("avx2")))
+static void move_avx2(scalar_t* x, scalar_t* z, const uint32_t* masks, uint32_t buttons, uint32_t count) {
+  const scalar_t positive_delta = get_move_delta();
+  const scalar_t negative_delta = -positive_delta;
+  int32_t positive_bits, negative_bits;
+  memcpy(&positive_bits, &positive_delta, sizeof(int32_t));
+  memcpy(&negative_bits, &negative_delta, sizeof(int32_t));
+  
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i input = _mm256_set1_epi32((int)buttons);
+  const __m256i left_bit = _mm256_set1_epi32((int)kLeftBit);
+  const __m256i right_bit = _mm256_set1_epi32((int)kRightBit);
+  const __m256i forward_bit = _mm256_set1_epi32((int)kForwardBit);
+  const __m256i back_bit = _mm256_set1_epi32((int)kBackBit);
+  const __m256i positive = _mm256_set1_epi32(positive_bits);
+  const __m256i negative = _mm256_set1_epi32(negative_bits);
+  
+  uint32_t i = 0;
+  for(; i + 8 <= count; i += 8) {
+    const __m256i lane = _mm256_and_si256(input, _mm256_loadu_si256((const __m256i*)(masks + i)));
+    // inverted key masks, all bits set when the key is up.
+    const __m256i left_up = _mm256_cmpeq_epi32(_mm256_and_si256(lane, left_bit), zero);
+    const __m256i right_up = _mm256_cmpeq_epi32(_mm256_and_si256(lane, right_bit), zero);
+    const __m256i forward_up = _mm256_cmpeq_epi32(_mm256_and_si256(lane, forward_bit), zero);
+    const __m256i back_up = _mm256_cmpeq_epi32(_mm256_and_si256(lane, back_bit), zero);
+    
+    const __m256i still_x = _mm256_and_si256(left_up, right_up);
+    const __m256i move_z = _mm256_andnot_si256(_mm256_and_si256(forward_up, back_up), still_x);
+    const __m256i dx = _mm256_blendv_epi8(negative, positive, left_up);
+    const __m256i dz = _mm256_blendv_epi8(negative, positive, forward_up);
+    
+    const __m256i px = _mm256_loadu_si256((const __m256i*)(x + i));
+    const __m256i pz = _mm256_loadu_si256((const __m256i*)(z + i));
+    _mm256_storeu_si256((__m256i*)(x + i), _mm256_blendv_epi8(add_lanes(px, dx), px, still_x));
+    _mm256_storeu_si256((__m256i*)(z + i), _mm256_blendv_epi8(pz, add_lanes(pz, dz), move_z));
+  }
+  move_sse2(x + i, z + i, masks + i, buttons, count - i);
+}
+
+#endif // SERVSIM_X86
+
+static MoveKernel detect_move_kernel() {
+#ifdef SERVSIM_X86
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx2")) {
+    return MoveKernel::kAvx2;
+  }
+  return MoveKernel::kSse2;
+#else
+  return MoveKernel::kScalar;
+#endif
+}
+
+MoveKernel get_move_kernel() {
+  static const MoveKernel kernel = detect_move_kernel();
+  return kernel;
+}
+
+const char* get_move_kernel_name(MoveKernel kernel) {
+  switch(kernel) {
+    case MoveKernel::kScalar: return "scalar";
+    case MoveKernel::kSse2: return "sse2";
+    case MoveKernel::kAvx2: return "avx2";
+  }
+  return "unknown";
+}
+
+bool moves_any_entity(const uint32_t* masks, uint32_t buttons, uint32_t count) {
+  const uint32_t move_buttons = buttons & kMoveBits;
+  if(move_buttons == 0) {
+    return false;
+  }
+  uint32_t any = 0;
+  for(uint32_t i = 0; i < count; ++i) {
+    any |= masks[i];
+  }
+  return (any & move_buttons) != 0;
+}
+
+void move_entities(scalar_t* x, scalar_t* z, const uint32_t* masks, uint32_t buttons, uint32_t count) {
+  move_entities(get_move_kernel(), x, z, masks, buttons, count);
+}
+
+void move_lanes(scalar_t* x, scalar_t* z, const uint32_t* lane_buttons, uint32_t count) {
+  // all buttons pass, the masks alone pick each lane's direction.
+  move_entities(get_move_kernel(), x, z, lane_buttons, ~0u, count);
+}
+
+void move_entities(MoveKernel kernel, scalar_t* x, scalar_t* z, const uint32_t* masks, uint32_t buttons, uint32_t count) {
+  if(buttons == 0) {
+    return;
+  }
+  
+  // never run a kernel the cpu does not support.
+  if(kernel > get_move_kernel()) {
+    kernel = MoveKernel::kScalar;
+  }
+  
+  switch(kernel) {
+#ifdef SERVSIM_X86
+    case MoveKernel::kAvx2:
+      move_avx2(x, z, masks, buttons, count);
+      break;
+    case MoveKernel::kSse2:
+      move_sse2(x, z, masks, buttons, count);
+      break;
+#endif
+    default:
+      move_scalar(x, z, masks, buttons, count);
+      break;
+  }
+}
@@ -0,0 +1,93 @@
+#include "common/prediction.h"
+#include <algorithm>
+
+static int64_t distance(int32_t a, int32_t b) {
+  const int64_t diff = (int64_t)a - b;
+  return diff < 0 ? -diff : diff;
+}
+
+ClientPrediction::ClientPrediction(Game& game, const SnapshotConfig& config, uint32_t tolerance)
+: m_game(game)
+, m_config(config)
+, m_tolerance(tolerance)
+, m_has_snapshot(false)
+, m_snapshot_tick(0) {
+}
+
+bool ClientPrediction::ApplySnapshot(const Snapshot& snapshot) {
+  if(m_has_snapshot && snapshot.m_tick <= m_snapshot_tick) {
+    return false;
+  }
+  if(!m_game.GetState(snapshot.m_tick, m_predicted)) {
+    return false;
+  }
+  m_has_snapshot = true;
+  m_snapshot_tick = snapshot.m_tick;
+  m_stats.m_num_snapshots += 1;
+  
+  if(!Correct(snapshot)) {
+    m_stats.m_last_resimulated = 0;
+    return true;
+  }
+  
+  m_game.SetState(snapshot.m_tick, m_predicted);
+  m_stats.m_num_misses += 1;
+  m_stats.m_last_resimulated = (uint32_t)(m_game.GetCurrentTick() - snapshot.m_tick);
+  m_stats.m_num_resimulated += m_stats.m_last_resimulated;
+  return true;
+}
+
+static bool has_entity(const Snapshot& snapshot, entity_t entity) {
+  const std::vector<SnapshotEntity>& entities = snapshot.m_entities;
+  std::vector<SnapshotEntity>::const_iterator it = std::lower_bound(entities.begin(), entities.end(), entity,
+    [](const SnapshotEntity& a, entity_t b) { return a.m_entity < b; });
+  return it != entities.end() && it->m_entity == entity;
+}
+
+static void set_entity(World& world, uint32_t index, const SnapshotEntity& authority, const SnapshotConfig& config) {
+  EntityChunk& chunk = world.GetMutableChunk(index / EntityChunk::kSize);
+  const uint32_t lane = index % EntityChunk::kSize;
+  const scalar3 position = get_snapshot_position(authority, config);
+  chunk.m_position_x[lane] = position.x;
+  chunk.m_position_y[lane] = position.y;
+  chunk.m_position_z[lane] = position.z;
+  chunk.m_rotation[lane] = get_snapshot_rotation(authority, config);
+}
+
+bool ClientPrediction::Correct(const Snapshot& snapshot) {
+  // entities the server does not have.
+  m_despawned.clear();
+  for(uint32_t i = 0; i < m_predicted.GetNumEntities(); ++i) {
+    if(!has_entity(snapshot, m_predicted.GetEntity(i))) {
+      m_despawned.push_back(m_predicted.GetEntity(i));
+    }
+  }
+  for(entity_t entity : m_despawned) {
+    m_predicted.Despawn(entity);
+  }
+  bool corrected = !m_despawned.empty();
+  
+  for(const SnapshotEntity& authority : snapshot.m_entities) {
+    uint32_t index;
+    if(!m_predicted.FindIndex(authority.m_entity, index)) {
+      // spawned by the server, the snapshot does not carry the rest of the cube.
+      m_predicted.SpawnWithId(authority.m_entity, Cube(), false);
+      m_predicted.FindIndex(authority.m_entity, index);
+      set_entity(m_predicted, index, authority, m_config);
+      corrected = true;
+      continue;
+    }
+    
+    SnapshotEntity predicted;
+    quantize_entity(m_predicted, index, m_config, predicted);
+    bool missed = false;
+    for(uint32_t f = 0; f < SnapshotEntity::kNumFields; ++f) {
+      missed |= distance(predicted.m_fields[f], authority.m_fields[f]) > m_tolerance;
+    }
+    if(missed) {
+      set_entity(m_predicted, index, authority, m_config);
+      corrected = true;
+    }
+  }
+  return corrected;
+}
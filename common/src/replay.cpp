@@ -0,0 +1,502 @@
+#include "common/replay.h"
+#include "common/bit_stream.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const uint32_t kMagic = 0x50525353; // "SSRP"
+static const uint32_t kVersion = 2;
+// the file grows by at least this much at once, each growth remaps it.
+static const size_t kMinGrowth = 4 << 20;
+#if SERVSIM_FIXED_POINT
+static const uint32_t kFixedPoint = 1;
+#else
+static const uint32_t kFixedPoint = 0;
+#endif
+
+enum RecordType : uint32_t {
+  kRecordEnd = 0,   // zeroed tail, nothing was written past it.
+  kRecordInput = 1,
+  kRecordKeyframe = 2,
+  kRecordFinish = 3,
+};
+
+// all records are padded to 8 bytes, every field is read with memcpy.
+struct FileHeader {
+  uint32_t m_magic;
+  uint32_t m_version;
+  uint32_t m_keyframe_interval;
+  uint32_t m_fixed_point;
+  uint32_t m_reserved[4];
+};
+
+struct RecordHeader {
+  uint32_t m_type;
+  uint32_t m_size;  // of the payload, without padding.
+};
+
+struct InputRecord {
+  uint32_t m_session;
+  uint32_t m_buttons;
+  uint64_t m_arrival_tick;  // current tick of the game when it arrived.
+  uint64_t m_tick;
+};
+
+// followed by the world.
+struct KeyframeRecord {
+  uint32_t m_session;
+  uint32_t m_history_length;  // of the recorded game, playing it back needs the same.
+  uint64_t m_tick;
+  uint64_t m_scan_offset;
+  uint64_t m_hash;
+};
+
+struct FinishRecord {
+  uint32_t m_session;
+  uint32_t m_reserved;
+  uint64_t m_tick;
+};
+
+static size_t pad_record(size_t size) {
+  return (size + 7) & ~(size_t)7;
+}
+
+ReplayRecorder::ReplayRecorder()
+: m_file(-1)
+, m_data(nullptr)
+, m_size(0)
+, m_capacity(0) {
+}
+
+ReplayRecorder::~ReplayRecorder() {
+  Close();
+}
+
+bool ReplayRecorder::Open(const char* path, const ReplayConfig& config) {
+  Close();
+  m_config = config;
+  if(m_config.m_keyframe_interval == 0) {
+    m_config.m_keyframe_interval = 1;
+  }
+  m_stats = ReplayRecorderStats();
+  m_sessions.clear();
+  
+  m_file = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if(m_file < 0 || !Reserve(sizeof(FileHeader))) {
+    Close();
+    return false;
+  }
+  
+  FileHeader header;
+  memset(&header, 0, sizeof(header));
+  header.m_magic = kMagic;
+  header.m_version = kVersion;
+  header.m_keyframe_interval = m_config.m_keyframe_interval;
+  header.m_fixed_point = kFixedPoint;
+  memcpy(m_data, &header, sizeof(header));
+  m_size = sizeof(header);
+  m_stats.m_num_bytes = m_size;
+  return true;
+}
+
+void ReplayRecorder::Close() {
+  if(m_data) {
+    for(uint32_t session = 0; session < m_sessions.size(); ++session) {
+      if(!m_sessions[session].m_active) {
+        continue;
+      }
+      FinishRecord record;
+      memset(&record, 0, sizeof(record));
+      record.m_session = session;
+      record.m_tick = m_sessions[session].m_tick;
+      Append(kRecordFinish, &record, sizeof(record), nullptr, 0);
+    }
+    munmap(m_data, m_capacity);
+    m_data = nullptr;
+  }
+  if(m_file >= 0) {
+    if(ftruncate(m_file, (off_t)m_size) != 0) {
+      // the zeroed tail reads as the end of the file, it only wastes space.
+    }
+    close(m_file);
+    m_file = -1;
+  }
+  m_size = 0;
+  m_capacity = 0;
+}
+
+bool ReplayRecorder::AddSession(uint32_t session, const Game& game) {
+  if(!m_data) {
+    return false;
+  }
+  if(session >= m_sessions.size()) {
+    m_sessions.resize(session + 1);
+  }
+  Session& state = m_sessions[session];
+  state.m_active = true;
+  state.m_first_tick = game.GetCurrentTick();
+  state.m_tick = game.GetCurrentTick();
+  state.m_history_length = game.GetHistoryLength();
+  // keyframes need the offset of ticks up to two history lengths back.
+  state.m_tick_offset.assign(state.m_history_length * 2, m_size);
+  return WriteKeyframe(session, state, state.m_tick, game.GetCurrentState());
+}
+
+bool ReplayRecorder::RecordInput(uint32_t session, const Game& game, tick_t tick, const Input& input) {
+  if(!m_data || session >= m_sessions.size() || !m_sessions[session].m_active) {
+    return false;
+  }
+  InputRecord record;
+  record.m_session = session;
+  record.m_buttons = input.GetButtons();
+  record.m_arrival_tick = game.GetCurrentTick();
+  record.m_tick = tick;
+  m_stats.m_num_inputs += 1;
+  return Append(kRecordInput, &record, sizeof(record), nullptr, 0);
+}
+
+bool ReplayRecorder::RecordStep(uint32_t session, Game& game) {
+  if(!m_data || session >= m_sessions.size() || !m_sessions[session].m_active) {
+    return false;
+  }
+  Session& state = m_sessions[session];
+  state.m_tick = game.GetCurrentTick();
+  state.m_tick_offset[state.m_tick % state.m_tick_offset.size()] = m_size;
+  
+  // inputs are accepted for ticks inside the history, the oldest state in
+  // it depends on none of them any more.
+  const tick_t history = state.m_history_length;
+  if(state.m_tick + 1 < history) {
+    return true;
+  }
+  const tick_t settled = state.m_tick + 1 - history;
+  if(settled <= state.m_first_tick || (settled - state.m_first_tick) % m_config.m_keyframe_interval != 0) {
+    return true;
+  }
+  World world;
+  return game.GetState(settled, world) && WriteKeyframe(session, state, settled, world);
+}
+
+bool ReplayRecorder::WriteKeyframe(uint32_t session, const Session& state, tick_t tick, const World& world) {
+  // inputs for 'tick' and later arrived at most one history length before it.
+  const tick_t history = state.m_history_length;
+  const tick_t scan_tick = tick >= state.m_first_tick + history - 1 ? tick + 1 - history : state.m_first_tick;
+  
+  KeyframeRecord record;
+  memset(&record, 0, sizeof(record));
+  record.m_session = session;
+  record.m_history_length = state.m_history_length;
+  record.m_tick = tick;
+  record.m_scan_offset = state.m_tick_offset[scan_tick % state.m_tick_offset.size()];
+  record.m_hash = world.GetHash();
+  
+  BitWriter writer;
+  world.Write(writer);
+  writer.Flush();
+  m_stats.m_num_keyframes += 1;
+  return Append(kRecordKeyframe, &record, sizeof(record), writer.GetData().data(), writer.GetData().size());
+}
+
+bool ReplayRecorder::Append(uint32_t type, const void* payload, size_t payload_size, const void* data, size_t data_size) {
+  const size_t size = payload_size + data_size;
+  const size_t record_size = sizeof(RecordHeader) + pad_record(size);
+  if(size > UINT32_MAX || !Reserve(m_size + record_size)) {
+    return false;
+  }
+  
+  // the type goes in last, readers stop at a record that is not complete.
+  uint8_t* record = m_data + m_size;
+  memcpy(record + sizeof(RecordHeader), payload, payload_size);
+  if(data_size > 0) {
+    memcpy(record + sizeof(RecordHeader) + payload_size, data, data_size);
+  }
+  RecordHeader header;
+  header.m_type = type;
+  header.m_size = (uint32_t)size;
+  memcpy(record + sizeof(uint32_t), &header.m_size, sizeof(header.m_size));
+  memcpy(record, &header.m_type, sizeof(header.m_type));
+  
+  m_size += record_size;
+  m_stats.m_num_bytes = m_size;
+  return true;
+}
+
+bool ReplayRecorder::Reserve(size_t size) {
+  if(size <= m_capacity) {
+    return true;
+  }
+  size_t capacity = m_capacity * 2 > kMinGrowth ? m_capacity * 2 : kMinGrowth;
+  capacity = capacity > size ? capacity : size;
+  
+  // the new part of the file reads as zeros.
+  if(m_data) {
+    munmap(m_data, m_capacity);
+    m_data = nullptr;
+  }
+  if(ftruncate(m_file, (off_t)capacity) != 0) {
+    return false;
+  }
+  void* data = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_file, 0);
+  if(data == MAP_FAILED) {
+    return false;
+  }
+  m_data = (uint8_t*)data;
+  m_capacity = capacity;
+  return true;
+}
+
+ReplayPlayer::ReplayPlayer()
+: m_file(-1)
+, m_data(nullptr)
+, m_size(0)
+, m_history_length(0)
+, m_session(0)
+, m_first_tick(0)
+, m_cursor(0)
+, m_next_keyframe(0)
+, m_end_keyframe(0) {
+}
+
+ReplayPlayer::~ReplayPlayer() {
+  Close();
+}
+
+bool ReplayPlayer::Open(const char* path) {
+  Close();
+  m_file = open(path, O_RDONLY);
+  struct stat info;
+  if(m_file < 0 || fstat(m_file, &info) != 0 || (size_t)info.st_size < sizeof(FileHeader)) {
+    Close();
+    return false;
+  }
+  void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_SHARED, m_file, 0);
+  if(data == MAP_FAILED) {
+    Close();
+    return false;
+  }
+  m_data = (const uint8_t*)data;
+  m_size = (size_t)info.st_size;
+  
+  FileHeader header;
+  memcpy(&header, m_data, sizeof(header));
+  if(header.m_magic != kMagic || header.m_version != kVersion || header.m_fixed_point != kFixedPoint) {
+    Close();
+    return false;
+  }
+  
+  // one pass over the record headers, payloads are only read for keyframes.
+  size_t offset = sizeof(FileHeader);
+  while(offset + sizeof(RecordHeader) <= m_size) {
+    RecordHeader record;
+    memcpy(&record, m_data + offset, sizeof(record));
+    const size_t payload = offset + sizeof(RecordHeader);
+    if(record.m_type == kRecordEnd || payload + record.m_size > m_size) {
+      break;
+    }
+    
+    uint32_t session = 0;
+    tick_t tick = 0;
+    if(record.m_type == kRecordInput && record.m_size >= sizeof(InputRecord)) {
+      InputRecord input;
+      memcpy(&input, m_data + payload, sizeof(input));
+      session = input.m_session;
+      tick = input.m_arrival_tick;
+    } else if(record.m_type == kRecordKeyframe && record.m_size >= sizeof(KeyframeRecord)) {
+      KeyframeRecord keyframe_record;
+      memcpy(&keyframe_record, m_data + payload, sizeof(keyframe_record));
+      Keyframe keyframe;
+      keyframe.m_session = keyframe_record.m_session;
+      keyframe.m_history_length = keyframe_record.m_history_length;
+      keyframe.m_tick = keyframe_record.m_tick;
+      keyframe.m_hash = keyframe_record.m_hash;
+      keyframe.m_offset = offset;
+      keyframe.m_scan_offset = (size_t)keyframe_record.m_scan_offset;
+      m_keyframes.push_back(keyframe);
+      session = keyframe.m_session;
+      tick = keyframe.m_tick;
+    } else if(record.m_type == kRecordFinish && record.m_size >= sizeof(FinishRecord)) {
+      FinishRecord finish;
+      memcpy(&finish, m_data + payload, sizeof(finish));
+      session = finish.m_session;
+      tick = finish.m_tick;
+    } else {
+      offset = payload + pad_record(record.m_size);
+      continue;
+    }
+    
+    LastTick* last = nullptr;
+    for(LastTick& entry : m_last_ticks) {
+      if(entry.m_session == session) {
+        last = &entry;
+        break;
+      }
+    }
+    if(!last) {
+      LastTick entry;
+      entry.m_session = session;
+      entry.m_tick = tick;
+      m_last_ticks.push_back(entry);
+    } else if(tick > last->m_tick) {
+      last->m_tick = tick;
+    }
+    offset = payload + pad_record(record.m_size);
+  }
+  // keyframes of one session were written in tick order, stable keeps it.
+  std::stable_sort(m_keyframes.begin(), m_keyframes.end());
+  return true;
+}
+
+void ReplayPlayer::Close() {
+  if(m_data) {
+    munmap((void*)m_data, m_size);
+    m_data = nullptr;
+  }
+  if(m_file >= 0) {
+    close(m_file);
+    m_file = -1;
+  }
+  m_size = 0;
+  m_keyframes.clear();
+  m_last_ticks.clear();
+  m_cursor = 0;
+  m_next_keyframe = 0;
+  m_end_keyframe = 0;
+  m_stats = ReplayPlayerStats();
+}
+
+void ReplayPlayer::GetSessions(std::vector<uint32_t>& sessions) const {
+  sessions.clear();
+  for(const LastTick& entry : m_last_ticks) {
+    sessions.push_back(entry.m_session);
+  }
+  std::sort(sessions.begin(), sessions.end());
+}
+
+void ReplayPlayer::GetKeyframes(uint32_t session, std::vector<tick_t>& ticks) const {
+  ticks.clear();
+  for(const Keyframe& keyframe : m_keyframes) {
+    if(keyframe.m_session == session) {
+      ticks.push_back(keyframe.m_tick);
+    }
+  }
+}
+
+bool ReplayPlayer::GetLastTick(uint32_t session, tick_t& tick) const {
+  for(const LastTick& entry : m_last_ticks) {
+    if(entry.m_session == session) {
+      tick = entry.m_tick;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ReplayPlayer::GetHistoryLength(uint32_t session, uint32_t& length) const {
+  for(const Keyframe& keyframe : m_keyframes) {
+    if(keyframe.m_session == session) {
+      length = keyframe.m_history_length;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ReplayPlayer::Seek(uint32_t session, tick_t tick, Game& game) {
+  Keyframe key;
+  key.m_session = session;
+  key.m_tick = 0;
+  const std::vector<Keyframe>::const_iterator begin = std::lower_bound(m_keyframes.begin(), m_keyframes.end(), key);
+  key.m_tick = ~(tick_t)0;
+  const std::vector<Keyframe>::const_iterator end = std::upper_bound(begin, m_keyframes.cend(), key);
+  // first keyframe after 'tick', the one before it is the one to start from.
+  key.m_tick = tick;
+  const std::vector<Keyframe>::const_iterator after = std::upper_bound(begin, end, key);
+  if(after == begin) {
+    return false;
+  }
+  const Keyframe& keyframe = *(after - 1);
+  if(keyframe.m_history_length != game.GetHistoryLength()) {
+    return false;
+  }
+  
+  RecordHeader record;
+  memcpy(&record, m_data + keyframe.m_offset, sizeof(record));
+  const uint8_t* world_data = m_data + keyframe.m_offset + sizeof(RecordHeader) + sizeof(KeyframeRecord);
+  BitReader reader(world_data, record.m_size - sizeof(KeyframeRecord));
+  World world;
+  if(!world.Read(reader)) {
+    return false;
+  }
+  game.Reset(keyframe.m_tick, world);
+  
+  m_session = session;
+  m_history_length = keyframe.m_history_length;
+  m_first_tick = keyframe.m_tick;
+  m_cursor = keyframe.m_scan_offset;
+  m_next_keyframe = (size_t)(after - m_keyframes.begin());
+  m_end_keyframe = (size_t)(end - m_keyframes.begin());
+  return true;
+}
+
+bool ReplayPlayer::Play(Game& game, tick_t tick) {
+  if(!m_data || m_cursor == 0) {
+    return false;
+  }
+  
+  while(m_cursor + sizeof(RecordHeader) <= m_size) {
+    RecordHeader record;
+    memcpy(&record, m_data + m_cursor, sizeof(record));
+    const size_t payload = m_cursor + sizeof(RecordHeader);
+    if(record.m_type == kRecordEnd || payload + record.m_size > m_size) {
+      break;
+    }
+    if(record.m_type == kRecordInput && record.m_size >= sizeof(InputRecord)) {
+      InputRecord input;
+      memcpy(&input, m_data + payload, sizeof(input));
+      if(input.m_session == m_session) {
+        // inputs of one game are recorded in the order they arrived.
+        if(input.m_arrival_tick > tick) {
+          break;
+        }
+        // earlier ticks only changed states before the keyframe.
+        if(input.m_tick >= m_first_tick) {
+          while(game.GetCurrentTick() < input.m_arrival_tick) {
+            Step(game);
+          }
+          game.UpdateInput(input.m_tick, Input(input.m_buttons));
+          m_stats.m_num_inputs += 1;
+        }
+      }
+    }
+    m_cursor = payload + pad_record(record.m_size);
+  }
+  
+  while(game.GetCurrentTick() < tick) {
+    Step(game);
+  }
+  return true;
+}
+
+void ReplayPlayer::Step(Game& game) {
+  game.Step();
+  m_stats.m_num_steps += 1;
+  
+  // the recorder wrote keyframes from the same point on, once they were final.
+  while(m_next_keyframe < m_end_keyframe) {
+    const Keyframe& keyframe = m_keyframes[m_next_keyframe];
+    if(keyframe.m_tick + m_history_length - 1 > game.GetCurrentTick()) {
+      break;
+    }
+    uint64_t hash;
+    if(game.GetStateHash(keyframe.m_tick, hash)) {
+      if(hash != keyframe.m_hash && m_stats.m_num_mismatches++ == 0) {
+        m_stats.m_first_mismatch = keyframe.m_tick;
+      }
+      m_stats.m_num_checked += 1;
+    }
+    m_next_keyframe += 1;
+  }
+}
@@ -0,0 +1,274 @@
+#include "common/session_host.h"
+#include <assert.h>
+#include <chrono>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// a shard never sleeps longer than this, so Stop() stays responsive.
+static const uint64_t kMaxSleepNs = 10000000;
+// passes start at most this often, so sessions spread over the tick period
+// are stepped in batches instead of one pass each.
+static const uint64_t kMinPassNs = 1000000;
+
+static void pin_thread(std::thread& thread, uint32_t core) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(core % CPU_SETSIZE, &set);
+  pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+  (void)thread;
+  (void)core;
+#endif
+}
+
+SessionHost::SessionHost(const SessionHostConfig& config)
+: m_config(config)
+, m_tick_period_ns(1000000000ull / (config.m_tick_rate > 0 ? config.m_tick_rate : 1))
+, m_num_sessions(0)
+, m_quit(false) {
+  uint32_t num_shards = config.m_num_threads;
+  if(num_shards == 0) {
+    num_shards = std::thread::hardware_concurrency();
+  }
+  if(num_shards == 0) {
+    num_shards = 1;
+  }
+  
+  for(uint32_t i = 0; i < num_shards; ++i) {
+    Shard* shard = new Shard();
+    shard->m_index = i;
+    shard->m_num_steps = 0;
+    shard->m_num_late_steps = 0;
+    shard->m_num_passes = 0;
+    shard->m_step_ns = 0;
+    shard->m_max_step_ns = 0;
+    shard->m_busy_ns = 0;
+    m_shards.push_back(shard);
+  }
+}
+
+SessionHost::~SessionHost() {
+  Stop();
+  for(Shard* shard : m_shards) {
+    delete shard;
+  }
+}
+
+session_t SessionHost::AddSession() {
+  assert(!IsRunning());
+  const session_t session = m_num_sessions++;
+  Shard& shard = *m_shards[session % m_shards.size()];
+  shard.m_games.emplace_back(m_config.m_checkpoint_interval, m_config.m_history_length);
+  shard.m_next_due_ns.push_back(0);
+  return session;
+}
+
+bool SessionHost::Start() {
+  if(IsRunning()) {
+    return true;
+  }
+  
+  if(!m_config.m_replay_path.empty()) {
+    for(Shard* shard : m_shards) {
+      const std::string path = m_config.m_replay_path + "." + std::to_string(shard->m_index);
+      if(!shard->m_recorder.Open(path.c_str(), m_config.m_replay)) {
+        CloseReplays();
+        return false;
+      }
+      for(size_t i = 0; i < shard->m_games.size(); ++i) {
+        shard->m_recorder.AddSession(GetSessionId(*shard, i), shard->m_games[i]);
+      }
+    }
+  }
+  
+  // spread the sessions of a shard over one tick period, so they do not all
+  // come due at once.
+  const uint64_t now = TickScheduler::NowNs();
+  for(Shard* shard : m_shards) {
+    const uint64_t count = shard->m_games.size();
+    for(uint64_t i = 0; i < count; ++i) {
+      shard->m_next_due_ns[i] = now + m_tick_period_ns * (i + 1) / count;
+    }
+  }
+  
+  m_quit = false;
+  for(uint32_t i = 0; i < m_shards.size(); ++i) {
+    m_threads.push_back(std::thread(&SessionHost::ShardMain, this, i));
+    if(m_config.m_pin_threads) {
+      pin_thread(m_threads.back(), i);
+    }
+  }
+  return true;
+}
+
+void SessionHost::Stop() {
+  m_quit = true;
+  for(std::thread& thread : m_threads) {
+    thread.join();
+  }
+  m_threads.clear();
+  CloseReplays();
+}
+
+void SessionHost::CloseReplays() {
+  for(Shard* shard : m_shards) {
+    shard->m_recorder.Close();
+  }
+}
+
+bool SessionHost::PostInput(session_t session, tick_t tick, const Input& input) {
+  if(session >= m_num_sessions) {
+    return false;
+  }
+  
+  Shard& shard = *m_shards[session % m_shards.size()];
+  QueuedInput queued;
+  queued.m_local = session / (uint32_t)m_shards.size();
+  queued.m_tick = tick;
+  queued.m_input = input;
+  
+  std::lock_guard<std::mutex> lock(shard.m_input_mutex);
+  shard.m_input_queue.push_back(queued);
+  return true;
+}
+
+SessionHostStats SessionHost::GetStats() const {
+  SessionHostStats stats;
+  stats.m_num_sessions = m_num_sessions;
+  stats.m_num_shards = GetNumShards();
+  for(const Shard* shard : m_shards) {
+    stats.m_num_steps += shard->m_num_steps.load(std::memory_order_relaxed);
+    stats.m_num_late_steps += shard->m_num_late_steps.load(std::memory_order_relaxed);
+    stats.m_num_passes += shard->m_num_passes.load(std::memory_order_relaxed);
+    stats.m_step_ns += shard->m_step_ns.load(std::memory_order_relaxed);
+    stats.m_busy_ns += shard->m_busy_ns.load(std::memory_order_relaxed);
+    const uint64_t max_step_ns = shard->m_max_step_ns.load(std::memory_order_relaxed);
+    if(max_step_ns > stats.m_max_step_ns) {
+      stats.m_max_step_ns = max_step_ns;
+    }
+  }
+  return stats;
+}
+
+bool SessionHost::GetSessionMetrics(session_t session, GameMetricsSnapshot& snapshot) const {
+  if(session >= m_num_sessions) {
+    return false;
+  }
+  // games are not added or moved while running, only their metrics change.
+  const Shard& shard = *m_shards[session % m_shards.size()];
+  shard.m_games[session / m_shards.size()].GetMetrics().GetSnapshot(snapshot);
+  return true;
+}
+
+void SessionHost::GetMetrics(GameMetricsSnapshot& snapshot) const {
+  snapshot = GameMetricsSnapshot();
+  GameMetricsSnapshot session;
+  for(const Shard* shard : m_shards) {
+    for(const Game& game : shard->m_games) {
+      game.GetMetrics().GetSnapshot(session);
+      snapshot.Add(session);
+    }
+  }
+}
+
+const Game& SessionHost::GetSession(session_t session) const {
+  assert(!IsRunning() && session < m_num_sessions);
+  const Shard& shard = *m_shards[session % m_shards.size()];
+  return shard.m_games[session / m_shards.size()];
+}
+
+void SessionHost::ShardMain(uint32_t index) {
+  Shard& shard = *m_shards[index];
+  while(!m_quit.load(std::memory_order_relaxed)) {
+    const uint64_t pass_start = TickScheduler::NowNs();
+    const uint64_t next_due = RunPass(shard, pass_start);
+    const uint64_t pass_end = TickScheduler::NowNs();
+    add_relaxed(shard.m_busy_ns, pass_end - pass_start);
+    add_relaxed(shard.m_num_passes, (uint64_t)1);
+    
+    uint64_t wake = pass_start + kMinPassNs;
+    wake = next_due > wake ? next_due : wake;
+    if(wake > pass_end) {
+      const uint64_t sleep_ns = wake - pass_end < kMaxSleepNs ? wake - pass_end : kMaxSleepNs;
+      std::this_thread::sleep_for(std::chrono::nanoseconds(sleep_ns));
+    }
+  }
+}
+
+// steps every due session once and returns the time the next one is due.
+uint64_t SessionHost::RunPass(Shard& shard, uint64_t now_ns) {
+  {
+    std::lock_guard<std::mutex> lock(shard.m_input_mutex);
+    shard.m_input_work.swap(shard.m_input_queue);
+  }
+  ReplayRecorder& recorder = shard.m_recorder;
+  for(const QueuedInput& queued : shard.m_input_work) {
+    Game& game = shard.m_games[queued.m_local];
+    if(game.UpdateInput(queued.m_tick, queued.m_input) && recorder.IsOpen()) {
+      recorder.RecordInput(GetSessionId(shard, queued.m_local), game, queued.m_tick, queued.m_input);
+    }
+  }
+  shard.m_input_work.clear();
+  
+  uint64_t next_due = now_ns + m_tick_period_ns;
+  uint64_t num_steps = 0;
+  uint64_t num_late = 0;
+  uint64_t step_ns = 0;
+  uint64_t max_step_ns = shard.m_max_step_ns.load(std::memory_order_relaxed);
+  
+  Game* games = shard.m_games.data();
+  uint64_t* due = shard.m_next_due_ns.data();
+  const size_t count = shard.m_games.size();
+  const uint32_t batch_lanes = m_config.m_batch_lanes;
+  for(size_t i = 0; i < count; ++i) {
+    if(due[i] <= now_ns) {
+      if(batch_lanes > 0) {
+        shard.m_due_games.push_back(&games[i]);
+      } else {
+        const uint64_t start = TickScheduler::NowNs();
+        games[i].Step();
+        const uint64_t duration = TickScheduler::NowNs() - start;
+        step_ns += duration;
+        max_step_ns = duration > max_step_ns ? duration : max_step_ns;
+        if(recorder.IsOpen()) {
+          recorder.RecordStep(GetSessionId(shard, i), games[i]);
+        }
+      }
+      num_steps += 1;
+      
+      // keep the cadence, a session that fell behind catches up one step per pass.
+      const uint64_t num_due = (now_ns - due[i]) / m_tick_period_ns + 1;
+      if(num_due > 1) {
+        num_late += 1;
+      }
+      games[i].GetMetrics().RecordTicksDue(num_due);
+      due[i] += m_tick_period_ns;
+    }
+    next_due = due[i] < next_due ? due[i] : next_due;
+  }
+  
+  const std::vector<Game*>& due_games = shard.m_due_games;
+  for(size_t begin = 0; begin < due_games.size(); begin += batch_lanes) {
+    const size_t group = due_games.size() - begin < batch_lanes ? due_games.size() - begin : batch_lanes;
+    const uint64_t start = TickScheduler::NowNs();
+    Game::StepBatch(&due_games[begin], (uint32_t)group, batch_lanes);
+    const uint64_t duration = TickScheduler::NowNs() - start;
+    step_ns += duration;
+    max_step_ns = duration > max_step_ns ? duration : max_step_ns;
+  }
+  if(recorder.IsOpen()) {
+    for(Game* game : due_games) {
+      recorder.RecordStep(GetSessionId(shard, (size_t)(game - games)), *game);
+    }
+  }
+  shard.m_due_games.clear();
+  
+  add_relaxed(shard.m_num_steps, num_steps);
+  add_relaxed(shard.m_num_late_steps, num_late);
+  add_relaxed(shard.m_step_ns, step_ns);
+  shard.m_max_step_ns.store(max_step_ns, std::memory_order_relaxed);
+  return next_due;
+}
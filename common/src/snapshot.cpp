@@ -0,0 +1,368 @@
+#include "common/snapshot.h"
+#include "common/tick_scheduler.h"
+#include <assert.h>
+#include <algorithm>
+#include <math.h>
+
+// bits per group of the variable length fields.
+static const uint32_t kTickGroupBits = 7;
+static const uint32_t kCountGroupBits = 5;
+static const uint32_t kIdGroupBits = 3;
+static const uint32_t kValueGroupBits = 7;
+static const uint32_t kDeltaGroupBits = 5;
+
+static const uint32_t kAllFields = (1u << SnapshotEntity::kNumFields) - 1;
+
+// rounds half away from zero, the same on every platform.
+static int32_t quantize(scalar_t value, float step) {
+  const double steps = (double)to_float(value) / step;
+  const double rounded = steps + (steps < 0.0 ? -0.5 : 0.5);
+  return (int32_t)std::max(std::min(rounded, (double)INT32_MAX), (double)INT32_MIN);
+}
+
+static bool less_entity(const SnapshotEntity& a, const SnapshotEntity& b) {
+  return a.m_entity < b.m_entity;
+}
+
+// bit per field that differs.
+static uint32_t get_changed_fields(const SnapshotEntity& current, const SnapshotEntity& baseline) {
+  uint32_t changed = 0;
+  for(uint32_t f = 0; f < SnapshotEntity::kNumFields; ++f) {
+    if(current.m_fields[f] != baseline.m_fields[f]) {
+      changed |= 1u << f;
+    }
+  }
+  return changed;
+}
+
+void quantize_world(const World& world, tick_t tick, const SnapshotConfig& config, Snapshot& snapshot) {
+  snapshot.m_tick = tick;
+  snapshot.m_entities.resize(world.GetNumEntities());
+  SnapshotEntity* entity = snapshot.m_entities.data();
+  for(uint32_t c = 0; c < world.GetNumChunks(); ++c) {
+    const EntityChunk& chunk = world.GetChunk(c);
+    const uint32_t first = c * EntityChunk::kSize;
+    for(uint32_t lane = 0; lane < world.GetChunkEntities(c); ++lane, ++entity) {
+      entity->m_entity = world.GetEntity(first + lane);
+      entity->m_fields[0] = quantize(chunk.m_position_x[lane], config.m_position_step);
+      entity->m_fields[1] = quantize(chunk.m_position_y[lane], config.m_position_step);
+      entity->m_fields[2] = quantize(chunk.m_position_z[lane], config.m_position_step);
+      entity->m_fields[3] = quantize(chunk.m_rotation[lane], config.m_rotation_step);
+    }
+  }
+  // dense order changes with every despawn, ids do not. without despawns
+  // it usually is sorted already.
+  if(!std::is_sorted(snapshot.m_entities.begin(), snapshot.m_entities.end(), less_entity)) {
+    std::sort(snapshot.m_entities.begin(), snapshot.m_entities.end(), less_entity);
+  }
+}
+
+void quantize_entity(const World& world, uint32_t index, const SnapshotConfig& config, SnapshotEntity& entity) {
+  const EntityChunk& chunk = world.GetChunk(index / EntityChunk::kSize);
+  const uint32_t lane = index % EntityChunk::kSize;
+  entity.m_entity = world.GetEntity(index);
+  entity.m_fields[0] = quantize(chunk.m_position_x[lane], config.m_position_step);
+  entity.m_fields[1] = quantize(chunk.m_position_y[lane], config.m_position_step);
+  entity.m_fields[2] = quantize(chunk.m_position_z[lane], config.m_position_step);
+  entity.m_fields[3] = quantize(chunk.m_rotation[lane], config.m_rotation_step);
+}
+
+scalar3 get_snapshot_position(const SnapshotEntity& entity, const SnapshotConfig& config) {
+  return scalar3(to_scalar(entity.m_fields[0] * config.m_position_step),
+                 to_scalar(entity.m_fields[1] * config.m_position_step),
+                 to_scalar(entity.m_fields[2] * config.m_position_step));
+}
+
+scalar_t get_snapshot_rotation(const SnapshotEntity& entity, const SnapshotConfig& config) {
+  return to_scalar(entity.m_fields[3] * config.m_rotation_step);
+}
+
+void filter_snapshot(const Snapshot& snapshot, const InterestSet& interest, Snapshot& filtered) {
+  filtered.m_tick = snapshot.m_tick;
+  filtered.m_entities.clear();
+  const std::vector<SnapshotEntity>& entities = snapshot.m_entities;
+  for(size_t i = 0, j = 0; i < entities.size() && j < interest.size();) {
+    if(entities[i].m_entity < interest[j]) {
+      ++i;
+    } else if(interest[j] < entities[i].m_entity) {
+      ++j;
+    } else {
+      filtered.m_entities.push_back(entities[i]);
+      ++i;
+      ++j;
+    }
+  }
+}
+
+// ids are written as the gap to the previous one.
+static void write_id(entity_t id, entity_t& previous, BitWriter& writer) {
+  writer.WriteVar(id - previous, kIdGroupBits);
+  previous = id;
+}
+
+static bool read_id(BitReader& reader, entity_t& previous, entity_t& id) {
+  uint64_t gap;
+  if(!reader.ReadVar(gap, kIdGroupBits) || gap > World::kInvalidEntity - previous) {
+    return false;
+  }
+  id = previous + (entity_t)gap;
+  previous = id;
+  return true;
+}
+
+void write_snapshot(const Snapshot& current, const Snapshot* baseline, BitWriter& writer) {
+  writer.WriteVar(current.m_tick, kTickGroupBits);
+  writer.WriteBool(baseline != nullptr);
+  if(baseline) {
+    assert(baseline->m_tick <= current.m_tick);
+    writer.WriteVar(current.m_tick - baseline->m_tick, kTickGroupBits);
+  }
+  
+  static const std::vector<SnapshotEntity> kNoEntities;
+  const std::vector<SnapshotEntity>& from = baseline ? baseline->m_entities : kNoEntities;
+  const std::vector<SnapshotEntity>& to = current.m_entities;
+  
+  // despawned, in the baseline only.
+  uint32_t num_despawned = 0;
+  for(size_t i = 0, j = 0; i < from.size(); ++i) {
+    while(j < to.size() && to[j].m_entity < from[i].m_entity) {
+      ++j;
+    }
+    num_despawned += j == to.size() || to[j].m_entity != from[i].m_entity ? 1 : 0;
+  }
+  writer.WriteVar(num_despawned, kCountGroupBits);
+  entity_t previous = 0;
+  for(size_t i = 0, j = 0; i < from.size(); ++i) {
+    while(j < to.size() && to[j].m_entity < from[i].m_entity) {
+      ++j;
+    }
+    if(j == to.size() || to[j].m_entity != from[i].m_entity) {
+      write_id(from[i].m_entity, previous, writer);
+    }
+  }
+  
+  // spawned or changed, new entities compare against all zeros.
+  uint32_t num_changed = 0;
+  for(size_t i = 0, j = 0; j < to.size(); ++j) {
+    while(i < from.size() && from[i].m_entity < to[j].m_entity) {
+      ++i;
+    }
+    const bool existed = i < from.size() && from[i].m_entity == to[j].m_entity;
+    num_changed += !existed || get_changed_fields(to[j], from[i]) ? 1 : 0;
+  }
+  writer.WriteVar(num_changed, kCountGroupBits);
+  previous = 0;
+  for(size_t i = 0, j = 0; j < to.size(); ++j) {
+    while(i < from.size() && from[i].m_entity < to[j].m_entity) {
+      ++i;
+    }
+    const SnapshotEntity& entity = to[j];
+    if(i < from.size() && from[i].m_entity == entity.m_entity) {
+      const uint32_t changed = get_changed_fields(entity, from[i]);
+      if(!changed) {
+        continue;
+      }
+      write_id(entity.m_entity, previous, writer);
+      writer.WriteBool(false);
+      writer.Write(changed, SnapshotEntity::kNumFields);
+      for(uint32_t f = 0; f < SnapshotEntity::kNumFields; ++f) {
+        if(changed & (1u << f)) {
+          writer.WriteSignedVar((int64_t)entity.m_fields[f] - from[i].m_fields[f], kDeltaGroupBits);
+        }
+      }
+    } else {
+      write_id(entity.m_entity, previous, writer);
+      writer.WriteBool(true);
+      for(uint32_t f = 0; f < SnapshotEntity::kNumFields; ++f) {
+        writer.WriteSignedVar(entity.m_fields[f], kValueGroupBits);
+      }
+    }
+  }
+}
+
+bool read_snapshot_header(BitReader& reader, SnapshotHeader& header) {
+  uint64_t tick, distance = 0;
+  bool has_baseline;
+  if(!reader.ReadVar(tick, kTickGroupBits) || !reader.ReadBool(has_baseline)) {
+    return false;
+  }
+  if(has_baseline && (!reader.ReadVar(distance, kTickGroupBits) || distance > tick)) {
+    return false;
+  }
+  header.m_tick = tick;
+  header.m_has_baseline = has_baseline;
+  header.m_baseline_tick = tick - distance;
+  return true;
+}
+
+static bool read_value(BitReader& reader, uint32_t group_bits, int64_t base, int32_t& value) {
+  int64_t read;
+  if(!reader.ReadSignedVar(read, group_bits)) {
+    return false;
+  }
+  const int64_t sum = base + read;
+  if(sum < INT32_MIN || sum > INT32_MAX) {
+    return false;
+  }
+  value = (int32_t)sum;
+  return true;
+}
+
+bool read_snapshot(BitReader& reader, const SnapshotHeader& header, const Snapshot* baseline, Snapshot& snapshot) {
+  if(header.m_has_baseline && (!baseline || baseline->m_tick != header.m_baseline_tick)) {
+    return false;
+  }
+  
+  static const std::vector<SnapshotEntity> kNoEntities;
+  const std::vector<SnapshotEntity>& from = header.m_has_baseline ? baseline->m_entities : kNoEntities;
+  
+  // the removals and updates are sorted, both merge in one pass over the baseline.
+  uint64_t num_despawned;
+  if(!reader.ReadVar(num_despawned, kCountGroupBits) || num_despawned > from.size()) {
+    return false;
+  }
+  std::vector<entity_t> despawned((size_t)num_despawned);
+  entity_t previous = 0;
+  for(entity_t& id : despawned) {
+    if(!read_id(reader, previous, id)) {
+      return false;
+    }
+  }
+  
+  uint64_t num_changed;
+  // every entity costs at least a few bits, bounds the allocation below.
+  if(!reader.ReadVar(num_changed, kCountGroupBits) || num_changed > reader.GetNumBitsLeft()) {
+    return false;
+  }
+  
+  std::vector<SnapshotEntity> entities;
+  entities.reserve(from.size() + (size_t)num_changed);
+  size_t next_from = 0;
+  size_t next_despawned = 0;
+  // copies baseline entities with smaller ids than 'id' that are not despawned.
+  auto copy_until = [&](uint64_t id) {
+    while(next_from < from.size() && from[next_from].m_entity < id) {
+      if(next_despawned < despawned.size() && despawned[next_despawned] == from[next_from].m_entity) {
+        ++next_despawned;
+      } else {
+        entities.push_back(from[next_from]);
+      }
+      ++next_from;
+    }
+  };
+  
+  previous = 0;
+  for(uint64_t n = 0; n < num_changed; ++n) {
+    SnapshotEntity entity;
+    bool is_new;
+    const entity_t previous_id = previous;
+    if(!read_id(reader, previous, entity.m_entity) || !reader.ReadBool(is_new)) {
+      return false;
+    }
+    if(n > 0 && entity.m_entity == previous_id) {
+      return false;
+    }
+    copy_until(entity.m_entity);
+    
+    const bool existed = next_from < from.size() && from[next_from].m_entity == entity.m_entity;
+    if(is_new == existed) {
+      return false;
+    }
+    if(is_new) {
+      for(uint32_t f = 0; f < SnapshotEntity::kNumFields; ++f) {
+        if(!read_value(reader, kValueGroupBits, 0, entity.m_fields[f])) {
+          return false;
+        }
+      }
+    } else {
+      const SnapshotEntity& base = from[next_from];
+      uint32_t changed;
+      if(!reader.Read(changed, SnapshotEntity::kNumFields)) {
+        return false;
+      }
+      for(uint32_t f = 0; f < SnapshotEntity::kNumFields; ++f) {
+        entity.m_fields[f] = base.m_fields[f];
+        if((changed & (1u << f)) && !read_value(reader, kDeltaGroupBits, base.m_fields[f], entity.m_fields[f])) {
+          return false;
+        }
+      }
+      ++next_from;
+    }
+    entities.push_back(entity);
+  }
+  copy_until((uint64_t)World::kInvalidEntity + 1);
+  
+  // every despawned id has to be one of the baseline.
+  if(next_despawned != despawned.size()) {
+    return false;
+  }
+  
+  snapshot.m_tick = header.m_tick;
+  snapshot.m_entities.swap(entities);
+  return true;
+}
+
+const tick_t SnapshotEncoder::kNoTick;
+
+SnapshotEncoder::SnapshotEncoder(const SnapshotConfig& config)
+: m_config(config) {
+  const uint32_t history_length = config.m_history_length > 0 ? config.m_history_length : 1;
+  m_sent.resize(history_length);
+  m_sent_tick.resize(history_length, kNoTick);
+}
+
+const Snapshot& SnapshotEncoder::Capture(const Game& game) {
+  const tick_t tick = game.GetCurrentTick();
+  const size_t index = tick % m_sent.size();
+  if(m_sent_tick[index] != tick) {
+    quantize_world(game.GetCurrentState(), tick, m_config, m_sent[index]);
+    m_sent_tick[index] = tick;
+  }
+  return m_sent[index];
+}
+
+const Snapshot* SnapshotEncoder::FindSent(tick_t tick) const {
+  const size_t index = tick % m_sent.size();
+  return m_sent_tick[index] == tick ? &m_sent[index] : nullptr;
+}
+
+void SnapshotEncoder::Encode(const Game& game, BitWriter& writer, const InterestSet* interest) {
+  const uint64_t start_ns = TickScheduler::NowNs();
+  const Snapshot* current = &Capture(game);
+  if(interest) {
+    filter_snapshot(*current, *interest, m_current);
+    current = &m_current;
+  }
+  Write(*current, nullptr, writer, start_ns);
+}
+
+bool SnapshotEncoder::Encode(const Game& game, tick_t baseline_tick, BitWriter& writer,
+                             const InterestSet* interest, const InterestSet* baseline_interest) {
+  const uint64_t start_ns = TickScheduler::NowNs();
+  const Snapshot* current = &Capture(game);
+  if(interest) {
+    filter_snapshot(*current, *interest, m_current);
+    current = &m_current;
+  }
+  
+  const Snapshot* baseline = baseline_tick <= current->m_tick ? FindSent(baseline_tick) : nullptr;
+  if(baseline && baseline_interest) {
+    filter_snapshot(*baseline, *baseline_interest, m_baseline);
+    baseline = &m_baseline;
+  }
+  Write(*current, baseline, writer, start_ns);
+  return baseline != nullptr;
+}
+
+void SnapshotEncoder::Write(const Snapshot& current, const Snapshot* baseline, BitWriter& writer, uint64_t start_ns) {
+  const uint32_t start_bits = writer.GetNumBits();
+  write_snapshot(current, baseline, writer);
+  const uint32_t num_bytes = (writer.GetNumBits() - start_bits + 7) / 8;
+  
+  m_stats.m_num_snapshots += 1;
+  m_stats.m_num_delta_snapshots += baseline ? 1 : 0;
+  m_stats.m_num_bytes += num_bytes;
+  m_stats.m_last_bytes = num_bytes;
+  m_stats.m_num_entities += current.m_entities.size();
+  m_stats.m_encode_ns += TickScheduler::NowNs() - start_ns;
+}
@@ -0,0 +1,92 @@
+#include "common/snapshot_cache.h"
+#include "common/hash.h"
+
+static uint64_t hash_interest(const InterestSet* interest) {
+  if(!interest) {
+    return 0;
+  }
+  return hash_bytes(interest->data(), interest->size() * sizeof(entity_t), kHashPrime4);
+}
+
+static bool same_interest(bool has_interest, const InterestSet& stored, const InterestSet* interest) {
+  if(!interest) {
+    return !has_interest;
+  }
+  return has_interest && stored == *interest;
+}
+
+SnapshotCache::SnapshotCache(const SnapshotConfig& config)
+: m_encoder(config)
+, m_tick(0) {
+}
+
+SnapshotPacketRef SnapshotCache::Get(const Game& game, const InterestSet* interest) {
+  return Find(game, false, 0, interest, nullptr);
+}
+
+SnapshotPacketRef SnapshotCache::Get(const Game& game, tick_t baseline_tick,
+                                     const InterestSet* interest, const InterestSet* baseline_interest) {
+  return Find(game, true, baseline_tick, interest, baseline_interest);
+}
+
+bool SnapshotCache::Matches(const Entry& entry, bool has_baseline, tick_t baseline_tick,
+                            const InterestSet* interest, const InterestSet* baseline_interest) {
+  if(entry.m_has_baseline != has_baseline) {
+    return false;
+  }
+  if(has_baseline && (entry.m_baseline_tick != baseline_tick ||
+                      !same_interest(entry.m_has_baseline_interest, entry.m_baseline_interest, baseline_interest))) {
+    return false;
+  }
+  return same_interest(entry.m_has_interest, entry.m_interest, interest);
+}
+
+SnapshotPacketRef SnapshotCache::Find(const Game& game, bool has_baseline, tick_t baseline_tick,
+                                      const InterestSet* interest, const InterestSet* baseline_interest) {
+  m_stats.m_num_requests += 1;
+  if(game.GetCurrentTick() != m_tick) {
+    m_entries.clear();
+    m_tick = game.GetCurrentTick();
+  }
+  
+  uint64_t key = hash_combine(kHashPrime1, has_baseline ? baseline_tick : ~(tick_t)0);
+  key = hash_combine(key, hash_interest(interest));
+  if(has_baseline) {
+    key = hash_combine(key, hash_interest(baseline_interest));
+  }
+  
+  auto range = m_entries.equal_range(key);
+  for(auto it = range.first; it != range.second; ++it) {
+    if(Matches(it->second, has_baseline, baseline_tick, interest, baseline_interest)) {
+      return it->second.m_packet;
+    }
+  }
+  
+  m_stats.m_num_encodes += 1;
+  m_writer.Clear();
+  std::shared_ptr<SnapshotPacket> packet = std::make_shared<SnapshotPacket>();
+  packet->m_tick = m_tick;
+  if(has_baseline) {
+    packet->m_has_baseline = m_encoder.Encode(game, baseline_tick, m_writer, interest, baseline_interest);
+    packet->m_baseline_tick = packet->m_has_baseline ? baseline_tick : 0;
+  } else {
+    m_encoder.Encode(game, m_writer, interest);
+  }
+  m_writer.Flush();
+  packet->m_data = m_writer.GetData();
+  
+  Entry entry;
+  entry.m_has_baseline = has_baseline;
+  entry.m_baseline_tick = baseline_tick;
+  entry.m_has_interest = interest != nullptr;
+  entry.m_has_baseline_interest = baseline_interest != nullptr;
+  if(interest) {
+    entry.m_interest = *interest;
+  }
+  if(has_baseline && baseline_interest) {
+    entry.m_baseline_interest = *baseline_interest;
+  }
+  entry.m_packet = packet;
+  m_entries.insert(std::make_pair(key, std::move(entry)));
+  return packet;
+}
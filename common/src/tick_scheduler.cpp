@@ -0,0 +1,76 @@
+#include "common/tick_scheduler.h"
+#include <chrono>
+
+TickScheduler::TickScheduler(const TickSchedulerConfig& config)
+: m_started(false)
+, m_next_due_ns(0)
+, m_last_update_ns(0) {
+  SetConfig(config);
+}
+
+void TickScheduler::SetConfig(const TickSchedulerConfig& config) {
+  m_config = config;
+  if(m_config.m_tick_period_ns == 0) {
+    m_config.m_tick_period_ns = 1;
+  }
+  if(m_config.m_max_steps_per_update == 0) {
+    m_config.m_max_steps_per_update = 1;
+  }
+}
+
+uint64_t TickScheduler::NowNs() {
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t TickScheduler::Update(uint64_t now_ns) {
+  const uint64_t period = m_config.m_tick_period_ns;
+  if(!m_started) {
+    m_started = true;
+    m_next_due_ns = now_ns + period;
+    m_last_update_ns = now_ns;
+    return 0;
+  }
+  
+  m_stats.m_num_updates += 1;
+  if(now_ns > m_last_update_ns) {
+    const uint64_t interval = now_ns - m_last_update_ns;
+    m_stats.m_max_update_interval_ns = interval > m_stats.m_max_update_interval_ns ? interval : m_stats.m_max_update_interval_ns;
+    m_last_update_ns = now_ns;
+  }
+  
+  uint32_t num_steps = 0;
+  if(m_next_due_ns <= now_ns) {
+    const uint64_t num_due = (now_ns - m_next_due_ns) / period + 1;
+    const uint32_t max_steps = m_config.m_max_steps_per_update;
+    num_steps = num_due < max_steps ? (uint32_t)num_due : max_steps;
+    m_next_due_ns += num_steps * period;
+    if(num_due > num_steps) {
+      m_stats.m_num_overruns += 1;
+      if(m_config.m_overrun_policy == OverrunPolicy::kSkip) {
+        m_stats.m_num_skipped_ticks += num_due - num_steps;
+        m_next_due_ns += (num_due - num_steps) * period;
+      }
+    }
+  }
+  
+  m_stats.m_num_steps += num_steps;
+  m_stats.m_num_catch_up_steps += num_steps > 1 ? num_steps - 1 : 0;
+  m_stats.m_last_steps = num_steps;
+  m_stats.m_max_steps = num_steps > m_stats.m_max_steps ? num_steps : m_stats.m_max_steps;
+  m_stats.m_lag_ns = m_next_due_ns <= now_ns ? now_ns - m_next_due_ns : 0;
+  m_stats.m_max_lag_ns = m_stats.m_lag_ns > m_stats.m_max_lag_ns ? m_stats.m_lag_ns : m_stats.m_max_lag_ns;
+  return num_steps;
+}
+
+float TickScheduler::GetAlpha(uint64_t now_ns) const {
+  const uint64_t period = m_config.m_tick_period_ns;
+  if(!m_started || now_ns >= m_next_due_ns) {
+    return m_started ? 1.f : 0.f;
+  }
+  const uint64_t remaining = m_next_due_ns - now_ns;
+  if(remaining >= period) {
+    return 0.f;
+  }
+  return (float)(period - remaining) / (float)period;
+}
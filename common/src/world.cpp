@@ -1,62 +1,809 @@
 #include "common/world.h"
+#include "common/movement.h"
+#include "common/job_system.h"
+#include "common/hash.h"
+#include "common/bit_stream.h"
+#include <string.h>
+#include <algorithm>
+#include <assert.h>
 
-static void tick_world(const World& previous, const Input& input, World& next) {
-  const float kMoveDelta = 0.1f;
+static const uint32_t kInvalidIndex = ~(uint32_t)0;
+static const float kHalfPi = 1.5707963f;
+
+const entity_t World::kInvalidEntity;
+const uint32_t EntityChunk::kSize;
+const tick_t Game::kInvalidTick;
+const uint32_t Game::kDefaultHistoryLength;
+
+World::World()
+: m_layout(std::make_shared<Layout>()) {
+}
+
+void World::CopyFrom(const World& other) {
+  if(this == &other) {
+    return;
+  }
+  m_chunks = other.m_chunks;
+  m_layout = other.m_layout;
+}
+
+World::Layout& World::GetMutableLayout() {
+  if(m_layout.use_count() > 1) {
+    m_layout = std::make_shared<Layout>(*m_layout);
+  }
+  m_layout->m_hash_valid = false;
+  return *m_layout;
+}
+
+EntityChunk& World::GetMutableChunk(uint32_t chunk) {
+  std::shared_ptr<EntityChunk>& data = m_chunks[chunk];
+  if(data.use_count() > 1) {
+    data = std::make_shared<EntityChunk>(*data);
+  }
+  data->m_hash_valid = false;
+  return *data;
+}
+
+template<typename T>
+static uint64_t hash_column(const std::vector<T>& column, uint64_t seed) {
+  return hash_bytes(column.data(), column.size() * sizeof(T), seed);
+}
+
+uint64_t World::GetHash() const {
+  Layout& layout = *m_layout;
+  if(!layout.m_hash_valid) {
+    uint64_t h = hash_column(layout.m_entity, 0);
+    h = hash_column(layout.m_scale, h);
+    h = hash_column(layout.m_color, h);
+    h = hash_column(layout.m_input_mask, h);
+    h = hash_column(layout.m_free_entities, h);
+    layout.m_hash = h;
+    layout.m_hash_valid = true;
+  }
+  
+  uint64_t h = layout.m_hash;
+  for(const std::shared_ptr<EntityChunk>& data : m_chunks) {
+    EntityChunk& chunk = *data;
+    if(!chunk.m_hash_valid) {
+      // unused lanes are kept zeroed, so the whole chunk can be hashed.
+      chunk.m_hash = hash_bytes(&chunk, offsetof(EntityChunk, m_hash));
+      chunk.m_hash_valid = true;
+    }
+    h = hash_combine(h, chunk.m_hash);
+  }
+  return hash_finalize(h);
+}
+
+uint32_t World::GetChunkEntities(uint32_t chunk) const {
+  const uint32_t first = chunk * EntityChunk::kSize;
+  const uint32_t count = GetNumEntities() - first;
+  return count < EntityChunk::kSize ? count : EntityChunk::kSize;
+}
+
+entity_t World::Spawn(const Cube& cube, bool controlled) {
+  Layout& layout = GetMutableLayout();
+  
+  entity_t entity;
+  if(!layout.m_free_entities.empty()) {
+    entity = layout.m_free_entities.back();
+    layout.m_free_entities.pop_back();
+  } else {
+    entity = (entity_t)layout.m_index.size();
+    layout.m_index.push_back(kInvalidIndex);
+  }
+  
+  Insert(entity, cube, controlled);
+  return entity;
+}
+
+bool World::SpawnWithId(entity_t entity, const Cube& cube, bool controlled) {
+  uint32_t index;
+  if(entity == kInvalidEntity || FindIndex(entity, index)) {
+    return false;
+  }
+  
+  Layout& layout = GetMutableLayout();
+  // ids skipped on the way are free.
+  while(layout.m_index.size() <= entity) {
+    layout.m_free_entities.push_back((entity_t)layout.m_index.size());
+    layout.m_index.push_back(kInvalidIndex);
+  }
+  std::vector<entity_t>& free_entities = layout.m_free_entities;
+  free_entities.erase(std::find(free_entities.begin(), free_entities.end(), entity));
+  
+  Insert(entity, cube, controlled);
+  return true;
+}
+
+void World::Insert(entity_t entity, const Cube& cube, bool controlled) {
+  Layout& layout = *m_layout;
+  const uint32_t index = GetNumEntities();
+  layout.m_index[entity] = index;
+  layout.m_entity.push_back(entity);
+  layout.m_scale.push_back(cube.m_scale);
+  layout.m_color.push_back(cube.m_color);
+  layout.m_input_mask.push_back(controlled ? ~0u : 0u);
+  
+  const uint32_t lane = index % EntityChunk::kSize;
+  if(lane == 0) {
+    m_chunks.push_back(std::make_shared<EntityChunk>());
+  }
+  EntityChunk& chunk = GetMutableChunk(index / EntityChunk::kSize);
+  chunk.m_position_x[lane] = to_scalar(cube.m_translation.x);
+  chunk.m_position_y[lane] = to_scalar(cube.m_translation.y);
+  chunk.m_position_z[lane] = to_scalar(cube.m_translation.z);
+  chunk.m_rotation[lane] = to_scalar(cube.m_rotation);
+}
+
+void World::Despawn(entity_t entity) {
+  uint32_t index;
+  if(!FindIndex(entity, index)) {
+    return;
+  }
+  
+  Layout& layout = GetMutableLayout();
+  
+  // keep the columns dense by moving the last entity into the hole.
+  const uint32_t last = GetNumEntities() - 1;
+  if(index != last) {
+    layout.m_entity[index] = layout.m_entity[last];
+    layout.m_scale[index] = layout.m_scale[last];
+    layout.m_color[index] = layout.m_color[last];
+    layout.m_input_mask[index] = layout.m_input_mask[last];
+    layout.m_index[layout.m_entity[index]] = index;
+    
+    const EntityChunk& from = GetChunk(last / EntityChunk::kSize);
+    const uint32_t from_lane = last % EntityChunk::kSize;
+    const scalar_t x = from.m_position_x[from_lane];
+    const scalar_t y = from.m_position_y[from_lane];
+    const scalar_t z = from.m_position_z[from_lane];
+    const scalar_t rotation = from.m_rotation[from_lane];
+    
+    EntityChunk& to = GetMutableChunk(index / EntityChunk::kSize);
+    const uint32_t to_lane = index % EntityChunk::kSize;
+    to.m_position_x[to_lane] = x;
+    to.m_position_y[to_lane] = y;
+    to.m_position_z[to_lane] = z;
+    to.m_rotation[to_lane] = rotation;
+  }
+  
+  layout.m_entity.pop_back();
+  layout.m_scale.pop_back();
+  layout.m_color.pop_back();
+  layout.m_input_mask.pop_back();
+  const uint32_t last_lane = last % EntityChunk::kSize;
+  if(last_lane == 0) {
+    m_chunks.pop_back();
+  } else {
+    // unused lanes stay zeroed, hashes rely on it.
+    EntityChunk& last_chunk = GetMutableChunk(last / EntityChunk::kSize);
+    last_chunk.m_position_x[last_lane] = scalar_t();
+    last_chunk.m_position_y[last_lane] = scalar_t();
+    last_chunk.m_position_z[last_lane] = scalar_t();
+    last_chunk.m_rotation[last_lane] = scalar_t();
+  }
+  
+  layout.m_index[entity] = kInvalidIndex;
+  layout.m_free_entities.push_back(entity);
+}
+
+bool World::FindIndex(entity_t entity, uint32_t& index) const {
+  const std::vector<uint32_t>& lookup = m_layout->m_index;
+  if(entity >= lookup.size() || lookup[entity] == kInvalidIndex) {
+    return false;
+  }
+  index = lookup[entity];
+  return true;
+}
+
+Cube World::GetCube(uint32_t index) const {
+  const EntityChunk& chunk = GetChunk(index / EntityChunk::kSize);
+  const uint32_t lane = index % EntityChunk::kSize;
+  Cube cube;
+  cube.m_translation = vec3(to_float(chunk.m_position_x[lane]),
+                            to_float(chunk.m_position_y[lane]),
+                            to_float(chunk.m_position_z[lane]));
+  cube.m_rotation = to_float(chunk.m_rotation[lane]);
+  cube.m_scale = m_layout->m_scale[index];
+  cube.m_color = m_layout->m_color[index];
+  return cube;
+}
+
+scalar3 World::GetTranslation(uint32_t index) const {
+  const EntityChunk& chunk = GetChunk(index / EntityChunk::kSize);
+  const uint32_t lane = index % EntityChunk::kSize;
+  return scalar3(chunk.m_position_x[lane], chunk.m_position_y[lane], chunk.m_position_z[lane]);
+}
+
+void World::SetColor(uint32_t index, const vec3& color) {
+  GetMutableLayout().m_color[index] = color;
+}
+
+void World::SetScale(uint32_t index, float scale) {
+  GetMutableLayout().m_scale[index] = scale;
+}
+
+static_assert(sizeof(scalar_t) == sizeof(uint32_t), "scalars are written as 32 bit words");
+
+static uint32_t to_bits(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+static uint32_t to_bits(fixed value) {
+  return (uint32_t)value.raw();
+}
+
+static bool read_bits(BitReader& reader, float& value) {
+  uint32_t bits;
+  if(!reader.Read(bits, 32)) {
+    return false;
+  }
+  memcpy(&value, &bits, sizeof(value));
+  return true;
+}
+
+static bool read_bits(BitReader& reader, fixed& value) {
+  uint32_t bits;
+  if(!reader.Read(bits, 32)) {
+    return false;
+  }
+  value = fixed::from_raw((int32_t)bits);
+  return true;
+}
+
+void World::Write(BitWriter& writer) const {
+  const Layout& layout = *m_layout;
+  writer.Write(GetNumEntities(), 32);
+  writer.Write((uint32_t)layout.m_index.size(), 32);
+  writer.Write((uint32_t)layout.m_free_entities.size(), 32);
+  for(uint32_t i = 0; i < GetNumEntities(); ++i) {
+    writer.Write(layout.m_entity[i], 32);
+    writer.Write(to_bits(layout.m_scale[i]), 32);
+    writer.Write(to_bits(layout.m_color[i].x), 32);
+    writer.Write(to_bits(layout.m_color[i].y), 32);
+    writer.Write(to_bits(layout.m_color[i].z), 32);
+    writer.Write(layout.m_input_mask[i], 32);
+  }
+  for(entity_t entity : layout.m_free_entities) {
+    writer.Write(entity, 32);
+  }
+  for(uint32_t c = 0; c < GetNumChunks(); ++c) {
+    const EntityChunk& chunk = GetChunk(c);
+    for(uint32_t lane = 0; lane < GetChunkEntities(c); ++lane) {
+      writer.Write(to_bits(chunk.m_position_x[lane]), 32);
+      writer.Write(to_bits(chunk.m_position_y[lane]), 32);
+      writer.Write(to_bits(chunk.m_position_z[lane]), 32);
+      writer.Write(to_bits(chunk.m_rotation[lane]), 32);
+    }
+  }
+}
+
+bool World::Read(BitReader& reader) {
+  uint32_t num_entities, num_ids, num_free;
+  if(!reader.Read(num_entities, 32) || !reader.Read(num_ids, 32) || !reader.Read(num_free, 32)
+     || num_ids < num_entities || num_ids - num_entities != num_free
+     || reader.GetNumBitsLeft() / 32 < (uint64_t)num_entities * 10 + num_free) {
+    return false;
+  }
+  
+  std::shared_ptr<Layout> layout = std::make_shared<Layout>();
+  layout->m_entity.resize(num_entities);
+  layout->m_scale.resize(num_entities);
+  layout->m_color.resize(num_entities);
+  layout->m_input_mask.resize(num_entities);
+  layout->m_index.assign(num_ids, kInvalidIndex);
+  layout->m_free_entities.resize(num_free);
+  for(uint32_t i = 0; i < num_entities; ++i) {
+    entity_t& entity = layout->m_entity[i];
+    vec3& color = layout->m_color[i];
+    if(!reader.Read(entity, 32) || !read_bits(reader, layout->m_scale[i])
+       || !read_bits(reader, color.x) || !read_bits(reader, color.y) || !read_bits(reader, color.z)
+       || !reader.Read(layout->m_input_mask[i], 32)
+       || entity >= num_ids || layout->m_index[entity] != kInvalidIndex) {
+      return false;
+    }
+    layout->m_index[entity] = i;
+  }
+  for(entity_t& entity : layout->m_free_entities) {
+    if(!reader.Read(entity, 32) || entity >= num_ids || layout->m_index[entity] != kInvalidIndex) {
+      return false;
+    }
+  }
   
-  next = previous;
+  std::vector<std::shared_ptr<EntityChunk>> chunks((num_entities + EntityChunk::kSize - 1) / EntityChunk::kSize);
+  for(uint32_t c = 0; c < chunks.size(); ++c) {
+    chunks[c] = std::make_shared<EntityChunk>();
+    EntityChunk& chunk = *chunks[c];
+    const uint32_t count = num_entities - c * EntityChunk::kSize < EntityChunk::kSize ? num_entities - c * EntityChunk::kSize : EntityChunk::kSize;
+    for(uint32_t lane = 0; lane < count; ++lane) {
+      if(!read_bits(reader, chunk.m_position_x[lane]) || !read_bits(reader, chunk.m_position_y[lane])
+         || !read_bits(reader, chunk.m_position_z[lane]) || !read_bits(reader, chunk.m_rotation[lane])) {
+        return false;
+      }
+    }
+  }
   
-  if(input.IsKeyDown(Input::Key::kLeft)) {
-    next.m_cube.m_translation.x -= kMoveDelta;
-  } else if(input.IsKeyDown(Input::Key::kRight)) {
-    next.m_cube.m_translation.x += kMoveDelta;
-  } else if(input.IsKeyDown(Input::Key::kForward)) {
-    next.m_cube.m_translation.z -= kMoveDelta;
-  } else if(input.IsKeyDown(Input::Key::kBack)) {
-    next.m_cube.m_translation.z += kMoveDelta;
+  m_layout = layout;
+  m_chunks.swap(chunks);
+  return true;
+}
+
+size_t World::GetMemoryUsage() const {
+  std::unordered_set<const void*> counted;
+  size_t bytes = 0;
+  CollectMemoryUsage(counted, bytes);
+  return bytes;
+}
+
+void World::CollectMemoryUsage(std::unordered_set<const void*>& counted, size_t& bytes) const {
+  bytes += sizeof(World) + m_chunks.capacity() * sizeof(m_chunks[0]);
+  for(const std::shared_ptr<EntityChunk>& chunk : m_chunks) {
+    if(counted.insert(chunk.get()).second) {
+      bytes += sizeof(EntityChunk);
+    }
+  }
+  
+  if(counted.insert(m_layout.get()).second) {
+    const Layout& layout = *m_layout;
+    bytes += sizeof(Layout)
+      + layout.m_scale.capacity() * sizeof(float)
+      + layout.m_color.capacity() * sizeof(vec3)
+      + layout.m_input_mask.capacity() * sizeof(uint32_t)
+      + layout.m_entity.capacity() * sizeof(entity_t)
+      + layout.m_index.capacity() * sizeof(uint32_t)
+      + layout.m_free_entities.capacity() * sizeof(entity_t);
   }
 }
 
-Game::Game()
-: m_current_tick(0)
-, m_tick_time(100.f)
-, m_tick_countdown(m_tick_time){
-  World& initial_state = m_state[0];
-  initial_state.m_cube.m_translation = vec3(0.f, 1.f, 0.f);
-  initial_state.m_cube.m_rotation = 0.f;
-  initial_state.m_cube.m_scale = 1.f;
+// chunks per job, 2048 entities.
+static const uint32_t kChunksPerJob = 32;
+
+// updates the chunks in [begin, end). chunks no entity moves in stay shared
+// with the previous tick.
+static void move_chunks(World& world, const Input& input, uint32_t begin, uint32_t end) {
+  const uint32_t buttons = input.GetButtons();
+  const uint32_t* masks = world.GetInputMask();
+  for(uint32_t c = begin; c < end; ++c) {
+    const uint32_t* chunk_masks = masks + c * EntityChunk::kSize;
+    const uint32_t count = world.GetChunkEntities(c);
+    if(!moves_any_entity(chunk_masks, buttons, count)) {
+      continue;
+    }
+    EntityChunk& chunk = world.GetMutableChunk(c);
+    move_entities(chunk.m_position_x, chunk.m_position_z, chunk_masks, buttons, count);
+  }
+}
+
+static void tick_world(const World& previous, const Input& input, World& next, JobSystem* jobs) {
+  next.CopyFrom(previous);
+  
+  const uint32_t num_chunks = next.GetNumChunks();
+  if(!jobs || num_chunks <= kChunksPerJob) {
+    move_chunks(next, input, 0, num_chunks);
+    return;
+  }
+  
+  // every chunk is updated independently, so any split gives the same result.
+  jobs->ParallelFor(num_chunks, kChunksPerJob, [&](uint32_t begin, uint32_t end) {
+    move_chunks(next, input, begin, end);
+  });
+}
+
+// moves the entities of several worlds by one tick, each with its own
+// buttons. entity i of every world shares one pass, a lane per world.
+static void move_interleaved(World* const* worlds, const uint32_t* buttons, uint32_t count) {
+  assert(count <= Game::kMaxBatchLanes);
+  scalar_t x[Game::kMaxBatchLanes];
+  scalar_t z[Game::kMaxBatchLanes];
+  uint32_t lane_buttons[Game::kMaxBatchLanes];
+  EntityChunk* chunks[Game::kMaxBatchLanes];
+  const uint32_t* masks[Game::kMaxBatchLanes];
+  uint32_t entities[Game::kMaxBatchLanes];
+  
+  uint32_t num_chunks = 0;
+  for(uint32_t k = 0; k < count; ++k) {
+    const uint32_t world_chunks = worlds[k]->GetNumChunks();
+    num_chunks = world_chunks > num_chunks ? world_chunks : num_chunks;
+  }
+  
+  for(uint32_t c = 0; c < num_chunks; ++c) {
+    // chunks no entity moves in stay shared, same as tick_world.
+    uint32_t num_entities = 0;
+    for(uint32_t k = 0; k < count; ++k) {
+      World& world = *worlds[k];
+      chunks[k] = nullptr;
+      entities[k] = 0;
+      if(c >= world.GetNumChunks()) {
+        continue;
+      }
+      masks[k] = world.GetInputMask() + c * EntityChunk::kSize;
+      const uint32_t chunk_entities = world.GetChunkEntities(c);
+      if(!moves_any_entity(masks[k], buttons[k], chunk_entities)) {
+        continue;
+      }
+      chunks[k] = &world.GetMutableChunk(c);
+      entities[k] = chunk_entities;
+      num_entities = chunk_entities > num_entities ? chunk_entities : num_entities;
+    }
+    
+    for(uint32_t i = 0; i < num_entities; ++i) {
+      for(uint32_t k = 0; k < count; ++k) {
+        if(i < entities[k]) {
+          x[k] = chunks[k]->m_position_x[i];
+          z[k] = chunks[k]->m_position_z[i];
+          lane_buttons[k] = masks[k][i] & buttons[k];
+        } else {
+          x[k] = scalar_t();
+          z[k] = scalar_t();
+          lane_buttons[k] = 0;
+        }
+      }
+      move_lanes(x, z, lane_buttons, count);
+      for(uint32_t k = 0; k < count; ++k) {
+        if(i < entities[k]) {
+          chunks[k]->m_position_x[i] = x[k];
+          chunks[k]->m_position_z[i] = z[k];
+        }
+      }
+    }
+  }
+}
+
+InterpolatedWorld::InterpolatedWorld(const World& from, const World& to, float alpha)
+: m_from(from)
+, m_to(to)
+, m_alpha(alpha < 0.f ? 0.f : (alpha > 1.f ? 1.f : alpha)) {
+}
+
+Cube InterpolatedWorld::GetCube(uint32_t index) const {
+  Cube cube = m_to.GetCube(index);
+  if(m_alpha >= 1.f) {
+    return cube;
+  }
+  // between two ticks entities mostly keep their dense index.
+  const entity_t entity = m_to.GetEntity(index);
+  uint32_t from_index = index;
+  if(from_index >= m_from.GetNumEntities() || m_from.GetEntity(from_index) != entity) {
+    if(!m_from.FindIndex(entity, from_index)) {
+      return cube;
+    }
+  }
+  const Cube from = m_from.GetCube(from_index);
+  cube.m_translation = vec3::lerp(from.m_translation, cube.m_translation, m_alpha);
+  cube.m_rotation = from.m_rotation + (cube.m_rotation - from.m_rotation) * m_alpha;
+  cube.m_scale = from.m_scale + (cube.m_scale - from.m_scale) * m_alpha;
+  return cube;
+}
+
+// smallest power of two of at least 'value'.
+static uint32_t round_up_pow2(uint32_t value) {
+  uint32_t result = 1;
+  while(result < value) {
+    result <<= 1;
+  }
+  return result;
+}
+
+Game::Game(uint32_t checkpoint_interval, uint32_t history_length)
+: m_history_length(history_length > 0 ? history_length : 1)
+, m_checkpoint_interval(checkpoint_interval > 0 ? checkpoint_interval : 1)
+, m_current_tick(0)
+, m_first_tick(0)
+, m_dirty_tick(0)
+, m_authority_tick(kInvalidTick)
+, m_jobs(nullptr)
+, m_keep_previous_state(false) {
+  const uint32_t history_size = round_up_pow2(m_history_length);
+  m_history_mask = history_size - 1;
+  m_pending_input.resize(history_size);
+  m_state_hash.resize(history_size);
+  // enough checkpoints to cover the oldest tick of the window.
+  const uint32_t num_checkpoints = (m_history_length + m_checkpoint_interval - 1) / m_checkpoint_interval + 1;
+  m_checkpoints.resize(num_checkpoints);
+  m_checkpoint_tick.resize(num_checkpoints, kInvalidTick);
+  // rolling back to the oldest tick replays inputs from its checkpoint on.
+  const uint32_t input_size = round_up_pow2(m_history_length + m_checkpoint_interval);
+  m_input_mask = input_size - 1;
+  m_input.resize(input_size);
+  
+  World& initial_state = m_current_state;
+  
+  Cube cube;
+  cube.m_translation = vec3(0.f, 1.f, 0.f);
+  cube.m_rotation = 0.f;
+  cube.m_scale = 1.f;
+  cube.m_color = vec3(1.f, 0.f, 1.f);
+  initial_state.Spawn(cube, true);
+  
+  Cube companion;
+  companion.m_translation = cube.m_translation + vec3(4.f, 0.f, 0.f);
+  companion.m_rotation = cube.m_rotation + kHalfPi;
+  companion.m_scale = cube.m_scale * 0.5f;
+  companion.m_color = vec3(0.f, 1.f, 1.f);
+  initial_state.Spawn(companion, true);
+  
+  m_checkpoints[CheckpointIndex(0)].CopyFrom(initial_state);
+  m_checkpoint_tick[CheckpointIndex(0)] = 0;
+  m_state_hash[Index(0)] = initial_state.GetHash();
+}
+
+uint32_t Game::CheckpointIndex(tick_t tick) const {
+  return (uint32_t)((tick / m_checkpoint_interval) % m_checkpoints.size());
 }
 
 void Game::UpdateInput(const Input& input) {
-  m_input[m_current_tick] = input;
+  UpdateInput(m_current_tick, input);
 }
 
-void Game::Update(float dt) {
-  m_tick_countdown -= dt;
-  uint32_t num_steps = 0;
-  while(m_tick_countdown <= 0.f) {
-    Step();
-    num_steps += 1;
-    m_tick_countdown += m_tick_time;
+bool Game::UpdateInput(tick_t tick, const Input& input) {
+  if(tick > m_current_tick) {
+    if(tick - m_current_tick >= m_history_length) {
+      m_metrics.RecordRejectedInput();
+      return false;
+    }
+    PendingInput& pending = m_pending_input[Index(tick)];
+    pending.m_tick = tick;
+    pending.m_input = input;
+    m_metrics.RecordInput(0);
+    return true;
+  }
+  
+  // resimulating from 'tick' needs its state to still be in the ring.
+  if(!IsInHistory(tick)) {
+    m_metrics.RecordRejectedInput();
+    return false;
+  }
+  m_metrics.RecordInput(m_current_tick - tick);
+  
+  m_input[InputIndex(tick)] = input;
+  // states from the authoritative one on only depend on later inputs.
+  const bool before_authority = m_authority_tick != kInvalidTick && tick < m_authority_tick;
+  if(tick < m_dirty_tick && !before_authority) {
+    m_dirty_tick = tick;
+  }
+  return true;
+}
+
+uint32_t Game::Update(uint64_t now_ns) {
+  const uint64_t num_skipped = m_scheduler.GetStats().m_num_skipped_ticks;
+  const uint32_t num_steps = m_scheduler.Update(now_ns);
+  const uint64_t num_due = num_steps + (m_scheduler.GetStats().m_num_skipped_ticks - num_skipped);
+  if(num_due > 0) {
+    m_metrics.RecordTicksDue(num_due);
   }
-  if(num_steps > 1) {
-    printf("warning: %u steps in one frame\n", num_steps);
+  for(uint32_t i = 0; i < num_steps; ++i) {
+    Step();
   }
+  return num_steps;
 }
 
 void Game::Step() {
+  const uint64_t start = TickScheduler::NowNs();
+  const tick_t first_tick = BeginStep();
+  tick_t from = first_tick;
+  if(m_keep_previous_state) {
+    Simulate(m_current_state, first_tick, m_current_tick - 1, true);
+    m_previous_state.CopyFrom(m_current_state);
+    from = m_current_tick - 1;
+  }
+  Simulate(m_current_state, from, m_current_tick, true);
+  EndStep(first_tick);
+  m_metrics.RecordStep(TickScheduler::NowNs() - start, m_step_stats.m_last_resimulated);
+}
+
+void Game::StepBatch(Game* const* games, uint32_t count, uint32_t lanes) {
+  lanes = lanes < 1 ? 1 : (lanes > kMaxBatchLanes ? kMaxBatchLanes : lanes);
+  
+  World* worlds[kMaxBatchLanes];
+  uint32_t buttons[kMaxBatchLanes];
+  tick_t first_tick[kMaxBatchLanes];
+  for(uint32_t begin = 0; begin < count; begin += lanes) {
+    const uint32_t group = count - begin < lanes ? count - begin : lanes;
+    const uint64_t start = TickScheduler::NowNs();
+    
+    // rollbacks resimulate alone up to the previous tick, the last tick of
+    // every game is left for the shared pass.
+    for(uint32_t k = 0; k < group; ++k) {
+      Game& game = *games[begin + k];
+      first_tick[k] = game.BeginStep();
+      const tick_t last_tick = game.m_current_tick - 1;
+      game.Simulate(game.m_current_state, first_tick[k], last_tick, true);
+      if(game.m_keep_previous_state) {
+        game.m_previous_state.CopyFrom(game.m_current_state);
+      }
+      worlds[k] = &game.m_current_state;
+      buttons[k] = game.m_input[game.InputIndex(last_tick)].GetButtons();
+    }
+    
+    move_interleaved(worlds, buttons, group);
+    
+    for(uint32_t k = 0; k < group; ++k) {
+      Game& game = *games[begin + k];
+      game.SaveState(game.m_current_tick);
+      game.EndStep(first_tick[k]);
+    }
+    // the games of a group share its time.
+    const uint64_t duration = (TickScheduler::NowNs() - start) / group;
+    for(uint32_t k = 0; k < group; ++k) {
+      Game& game = *games[begin + k];
+      game.m_metrics.RecordStep(duration, game.m_step_stats.m_last_resimulated);
+    }
+  }
+}
+
+tick_t Game::BeginStep() {
   tick_t previous_tick = m_current_tick;
   ++m_current_tick;
-  if(m_current_tick >= kGameLoopLength) {
-    m_current_tick = 0;
+  
+  // the slot of the new tick still holds input from a full loop ago.
+  PendingInput& pending = m_pending_input[Index(m_current_tick)];
+  Input& current_input = m_input[InputIndex(m_current_tick)];
+  if(pending.m_tick == m_current_tick) {
+    current_input = pending.m_input;
+    pending.m_tick = kInvalidTick;
+  } else {
+    current_input = Input();
   }
   
-  for(tick_t t = 0; t < m_current_tick; ++t) {
-    tick_world(m_state[t], m_input[t], m_state[t+1]);
+  // states up to the dirty tick are still valid, only the ones produced
+  // from changed inputs and the new tick need simulating. a rollback restarts
+  // from the closest checkpoint before the dirty tick.
+  tick_t first_tick = previous_tick;
+  if(m_dirty_tick < previous_tick) {
+    first_tick = RestoreState(m_dirty_tick, m_current_state);
+  }
+  return first_tick;
+}
+
+void Game::EndStep(tick_t first_tick) {
+  m_dirty_tick = m_current_tick;
+  
+  m_step_stats.m_last_resimulated = (uint32_t)(m_current_tick - first_tick);
+  m_step_stats.m_total_resimulated += m_step_stats.m_last_resimulated;
+  m_step_stats.m_num_steps += 1;
+}
+
+void Game::Simulate(World& state, tick_t from, tick_t to, bool save_checkpoints) {
+  for(tick_t t = from; t < to; ++t) {
+    tick_world(state, m_input[InputIndex(t)], state, m_jobs);
+    if(save_checkpoints) {
+      assert(&state == &m_current_state);
+      SaveState(t + 1);
+    }
+  }
+}
+
+void Game::SaveState(tick_t tick) {
+  m_state_hash[Index(tick)] = m_current_state.GetHash();
+  if(tick % m_checkpoint_interval == 0) {
+    const uint32_t index = CheckpointIndex(tick);
+    m_checkpoints[index].CopyFrom(m_current_state);
+    m_checkpoint_tick[index] = tick;
+  }
+}
+
+bool Game::IsInHistory(tick_t tick) const {
+  return tick <= m_current_tick && tick + m_history_length > m_current_tick && tick >= m_first_tick;
+}
+
+bool Game::GetStateHash(tick_t tick, uint64_t& hash) const {
+  if(!IsInHistory(tick)) {
+    return false;
+  }
+  hash = m_state_hash[Index(tick)];
+  return true;
+}
+
+bool Game::GetState(tick_t tick, World& state) {
+  if(!IsInHistory(tick)) {
+    return false;
+  }
+  
+  uint32_t num_resimulated = 0;
+  if(tick == m_current_tick && m_dirty_tick >= m_current_tick) {
+    state.CopyFrom(m_current_state);
+  } else {
+    // checkpoints after the dirty tick are stale until the next Step().
+    const tick_t valid_tick = tick < m_dirty_tick ? tick : m_dirty_tick;
+    const tick_t restored_tick = RestoreState(valid_tick, state);
+    Simulate(state, restored_tick, tick, false);
+    num_resimulated = (uint32_t)(tick - restored_tick);
+  }
+  
+  m_history_stats.m_last_query_resimulated = num_resimulated;
+  m_history_stats.m_total_query_resimulated += num_resimulated;
+  m_history_stats.m_num_queries += 1;
+  return true;
+}
+
+bool Game::SetState(tick_t tick, const World& state) {
+  if(!IsInHistory(tick)) {
+    return false;
   }
   
-  /*printf("tick: %llu, ", m_current_tick);
-  printf("input: %c%c%c%c\n", m_input[previous_tick].IsKeyDown(Input::Key::kForward) ? 'w' : '-',
-                               m_input[previous_tick].IsKeyDown(Input::Key::kBack) ? 's' : '-',
-                               m_input[previous_tick].IsKeyDown(Input::Key::kLeft) ? 'a' : '-',
-                               m_input[previous_tick].IsKeyDown(Input::Key::kRight) ? 'd' : '-');*/
+  m_authority_state.CopyFrom(state);
+  m_authority_tick = tick;
+  m_state_hash[Index(tick)] = state.GetHash();
+  if(tick % m_checkpoint_interval == 0) {
+    const uint32_t index = CheckpointIndex(tick);
+    m_checkpoints[index].CopyFrom(state);
+    m_checkpoint_tick[index] = tick;
+  }
+  
+  // earlier dirty ticks no longer matter, states before 'tick' stay as they were.
+  m_dirty_tick = tick;
+  if(tick == m_current_tick) {
+    m_current_state.CopyFrom(state);
+  }
+  return true;
+}
+
+void Game::SetKeepPreviousState(bool keep) {
+  m_keep_previous_state = keep;
+  if(keep) {
+    m_previous_state.CopyFrom(m_current_state);
+  } else {
+    m_previous_state = World();
+  }
+}
+
+void Game::Reset(tick_t tick, const World& state) {
+  m_current_tick = tick;
+  m_first_tick = tick;
+  m_dirty_tick = tick;
+  m_current_state.CopyFrom(state);
+  if(m_keep_previous_state) {
+    m_previous_state.CopyFrom(state);
+  }
+  std::fill(m_input.begin(), m_input.end(), Input());
+  for(PendingInput& pending : m_pending_input) {
+    pending = PendingInput();
+  }
+  std::fill(m_checkpoint_tick.begin(), m_checkpoint_tick.end(), kInvalidTick);
+  
+  // authoritative states of the old history do not apply to the new one.
+  m_reset_state.CopyFrom(state);
+  m_authority_state = World();
+  m_authority_tick = kInvalidTick;
+  SaveState(tick);
+  m_scheduler.Restart();
+}
+
+tick_t Game::RestoreState(tick_t tick, World& state) const {
+  const tick_t checkpoint_tick = GetCheckpointTick(tick);
+  if(m_authority_tick != kInvalidTick && m_authority_tick >= checkpoint_tick && m_authority_tick <= tick) {
+    state.CopyFrom(m_authority_state);
+    return m_authority_tick;
+  }
+  // the checkpoint would be from before the reset.
+  if(checkpoint_tick < m_first_tick) {
+    state.CopyFrom(m_reset_state);
+    return m_first_tick;
+  }
+  
+  const uint32_t index = CheckpointIndex(checkpoint_tick);
+  assert(m_checkpoint_tick[index] == checkpoint_tick);
+  state.CopyFrom(m_checkpoints[index]);
+  return checkpoint_tick;
+}
+
+size_t Game::GetHistoryMemoryUsage() const {
+  size_t usage = m_input.capacity() * sizeof(Input) + m_pending_input.capacity() * sizeof(PendingInput);
+  usage += m_state_hash.capacity() * sizeof(uint64_t);
+  usage += m_checkpoint_tick.capacity() * sizeof(tick_t);
+  
+  // checkpoints share the chunks that did not change between them.
+  std::unordered_set<const void*> counted;
+  m_current_state.CollectMemoryUsage(counted, usage);
+  if(m_keep_previous_state) {
+    m_previous_state.CollectMemoryUsage(counted, usage);
+  }
+  for(const World& checkpoint : m_checkpoints) {
+    checkpoint.CollectMemoryUsage(counted, usage);
+  }
+  m_reset_state.CollectMemoryUsage(counted, usage);
+  m_authority_state.CollectMemoryUsage(counted, usage);
+  return usage;
 }
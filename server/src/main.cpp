@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "common/replay.h"
+#include "common/session_host.h"
+#include "common/tick_scheduler.h"
+
+static std::atomic<bool> g_quit(false);
+
+static void on_signal(int) {
+  g_quit = true;
+}
+
+static double get_seconds_since(uint64_t start_ns) {
+  return (double)(TickScheduler::NowNs() - start_ns) / 1e9;
+}
+
+struct ServerConfig {
+  SessionHostConfig m_host;
+  uint32_t m_num_sessions = 1;
+  double m_duration = 0.0;     // seconds, 0 runs until interrupted.
+  
+  // plays a recorded session back instead of hosting any.
+  const char* m_replay = nullptr;
+  uint32_t m_replay_session = 0;
+  tick_t m_seek_tick = 0;
+  tick_t m_replay_to = ~(tick_t)0;  // stops at the end of the recording by default.
+};
+
+static void print_usage(const char* name) {
+  printf("usage: %s [--tick-rate <hz>] [--duration <seconds>] [--sessions <count>]\n"
+         "          [--threads <count>] [--checkpoint-interval <ticks>] [--history <ticks>] [--no-pin]\n"
+         "          [--batch-lanes <count>] [--record <path>] [--keyframe-interval <ticks>]\n"
+         "       %s --replay <file> [--session <id>] [--seek <tick>] [--to <tick>]\n", name, name);
+}
+
+static bool parse_args(int argc, const char* argv[], ServerConfig& config) {
+  for(int i = 1; i < argc; ++i) {
+    const bool has_value = i + 1 < argc;
+    if(0 == strcmp(argv[i], "--tick-rate") && has_value) {
+      config.m_host.m_tick_rate = (uint32_t)atoi(argv[++i]);
+    } else if(0 == strcmp(argv[i], "--duration") && has_value) {
+      config.m_duration = atof(argv[++i]);
+    } else if(0 == strcmp(argv[i], "--sessions") && has_value) {
+      config.m_num_sessions = (uint32_t)atoi(argv[++i]);
+    } else if(0 == strcmp(argv[i], "--threads") && has_value) {
+      config.m_host.m_num_threads = (uint32_t)atoi(argv[++i]);
+    } else if(0 == strcmp(argv[i], "--checkpoint-interval") && has_value) {
+      config.m_host.m_checkpoint_interval = (uint32_t)atoi(argv[++i]);
+    } else if(0 == strcmp(argv[i], "--history") && has_value) {
+      config.m_host.m_history_length = (uint32_t)atoi(argv[++i]);
+    } else if(0 == strcmp(argv[i], "--batch-lanes") && has_value) {
+      config.m_host.m_batch_lanes = (uint32_t)atoi(argv[++i]);
+    } else if(0 == strcmp(argv[i], "--record") && has_value) {
+      config.m_host.m_replay_path = argv[++i];
+    } else if(0 == strcmp(argv[i], "--keyframe-interval") && has_value) {
+      config.m_host.m_replay.m_keyframe_interval = (uint32_t)atoi(argv[++i]);
+    } else if(0 == strcmp(argv[i], "--replay") && has_value) {
+      config.m_replay = argv[++i];
+    } else if(0 == strcmp(argv[i], "--session") && has_value) {
+      config.m_replay_session = (uint32_t)atoi(argv[++i]);
+    } else if(0 == strcmp(argv[i], "--seek") && has_value) {
+      config.m_seek_tick = (tick_t)strtoull(argv[++i], nullptr, 10);
+    } else if(0 == strcmp(argv[i], "--to") && has_value) {
+      config.m_replay_to = (tick_t)strtoull(argv[++i], nullptr, 10);
+    } else if(0 == strcmp(argv[i], "--no-pin")) {
+      config.m_host.m_pin_threads = false;
+    } else {
+      return false;
+    }
+  }
+  return config.m_host.m_tick_rate > 0 && config.m_num_sessions > 0;
+}
+
+static void print_stats(const ServerConfig& config, const SessionHostStats& stats, double elapsed) {
+  printf("sessions: %u on %u threads, %.2f s\n", stats.m_num_sessions, stats.m_num_shards, elapsed);
+  printf("ticks: %llu (%.2f hz per session, target %u hz)\n", (unsigned long long)stats.m_num_steps,
+         elapsed > 0.0 ? stats.m_num_steps / elapsed / stats.m_num_sessions : 0.0,
+         config.m_host.m_tick_rate);
+  if(stats.m_num_steps == 0) {
+    return;
+  }
+  
+  printf("step time (us): mean %.2f, max %.2f\n",
+         stats.m_step_ns / 1000.0 / stats.m_num_steps, stats.m_max_step_ns / 1000.0);
+  printf("late ticks: %llu\n", (unsigned long long)stats.m_num_late_steps);
+  
+  // sessions a fully busy core could keep up with at this tick rate.
+  const double busy = stats.m_busy_ns / 1e9 / (elapsed * stats.m_num_shards);
+  const double sessions_per_core = stats.m_num_sessions / (double)stats.m_num_shards;
+  printf("core load: %.2f%%, %.1f sessions per core, capacity %.0f sessions per core\n",
+         busy * 100.0, sessions_per_core, busy > 0.0 ? sessions_per_core / busy : 0.0);
+}
+
+static void print_histogram(const char* name, const HistogramSnapshot& histogram, double scale) {
+  printf("%s: count %llu, mean %.2f, p50 %.2f, p99 %.2f, max %.2f\n", name,
+         (unsigned long long)histogram.GetCount(), histogram.GetMean() * scale,
+         histogram.GetQuantile(0.5) * scale, histogram.GetQuantile(0.99) * scale, histogram.m_max * scale);
+}
+
+// quantiles are bucket bounds, exact within a factor of two.
+static void print_metrics(const GameMetricsSnapshot& metrics) {
+  print_histogram("game step (us)", metrics.m_step_ns, 1e-3);
+  print_histogram("ticks simulated per step", metrics.m_resimulated, 1.0);
+  print_histogram("ticks due per step", metrics.m_ticks_due, 1.0);
+  print_histogram("input lateness (ticks)", metrics.m_input_lateness, 1.0);
+  printf("rejected inputs: %llu\n", (unsigned long long)metrics.m_num_rejected_inputs);
+}
+
+// headless playback, as fast as the game steps.
+static int run_replay(const ServerConfig& config) {
+  ReplayPlayer player;
+  if(!player.Open(config.m_replay)) {
+    printf("can not read replay %s\n", config.m_replay);
+    return 1;
+  }
+  tick_t last_tick;
+  uint32_t history_length;
+  if(!player.GetLastTick(config.m_replay_session, last_tick)
+     || !player.GetHistoryLength(config.m_replay_session, history_length)) {
+    printf("no session %u in replay %s\n", config.m_replay_session, config.m_replay);
+    return 1;
+  }
+  Game game(config.m_host.m_checkpoint_interval, history_length);
+  if(!player.Seek(config.m_replay_session, config.m_seek_tick, game)) {
+    printf("no keyframe of session %u at or before tick %llu\n", config.m_replay_session,
+           (unsigned long long)config.m_seek_tick);
+    return 1;
+  }
+  
+  const tick_t first_tick = game.GetCurrentTick();
+  const tick_t to_tick = config.m_replay_to < last_tick ? config.m_replay_to : last_tick;
+  const uint64_t start_ns = TickScheduler::NowNs();
+  player.Play(game, to_tick);
+  const double elapsed = get_seconds_since(start_ns);
+  
+  const ReplayPlayerStats& stats = player.GetStats();
+  uint64_t hash = 0;
+  game.GetStateHash(game.GetCurrentTick(), hash);
+  printf("session %u: ticks %llu to %llu, %llu inputs, %.3f s (%.0f ticks/s)\n", config.m_replay_session,
+         (unsigned long long)first_tick, (unsigned long long)game.GetCurrentTick(),
+         (unsigned long long)stats.m_num_inputs, elapsed, elapsed > 0.0 ? stats.m_num_steps / elapsed : 0.0);
+  printf("keyframes checked: %llu, mismatched: %llu", (unsigned long long)stats.m_num_checked,
+         (unsigned long long)stats.m_num_mismatches);
+  if(stats.m_num_mismatches > 0) {
+    printf(", first at tick %llu", (unsigned long long)stats.m_first_mismatch);
+  }
+  printf("\nstate hash at tick %llu: %016llx\n", (unsigned long long)game.GetCurrentTick(), (unsigned long long)hash);
+  return stats.m_num_mismatches > 0 ? 2 : 0;
+}
+
+int main(int argc, const char* argv[]) {
+  ServerConfig config;
+  if(!parse_args(argc, argv, config)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  if(config.m_replay) {
+    return run_replay(config);
+  }
+  
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+  
+  SessionHost host(config.m_host);
+  for(uint32_t i = 0; i < config.m_num_sessions; ++i) {
+    host.AddSession();
+  }
+  
+  printf("servsim server running %u sessions at %u hz\n", config.m_num_sessions, config.m_host.m_tick_rate);
+  
+  const uint64_t start_ns = TickScheduler::NowNs();
+  if(!host.Start()) {
+    printf("can not create replay files at %s\n", config.m_host.m_replay_path.c_str());
+    return 1;
+  }
+  while(!g_quit) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    const double elapsed = get_seconds_since(start_ns);
+    if(config.m_duration > 0.0 && elapsed >= config.m_duration) {
+      break;
+    }
+  }
+  host.Stop();
+  
+  const double elapsed = get_seconds_since(start_ns);
+  print_stats(config, host.GetStats(), elapsed);
+  GameMetricsSnapshot metrics;
+  host.GetMetrics(metrics);
+  print_metrics(metrics);
+  return 0;
+}
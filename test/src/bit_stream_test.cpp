@@ -0,0 +1,279 @@
+#include <utility>
+#include <vector>
+#include "common/bit_stream.h"
+#include "common/input_packet.h"
+#include "test_util.h"
+
+// round trips of the bit stream and the input packets: every bit width at
+// every alignment, variable length values at their group boundaries, input
+// runs at the boundaries of the window and of the run length field, and
+// reads of truncated or malformed data, which have to fail.
+
+static uint32_t get_mask(uint32_t num_bits) {
+  return num_bits == 32 ? ~0u : (1u << num_bits) - 1;
+}
+
+// every width from 0 to 32 bits, after every misalignment of 0 to 31 bits,
+// with zero, all ones and random values.
+static void test_bit_widths() {
+  for(uint32_t offset = 0; offset < 32; ++offset) {
+    for(uint32_t num_bits = 0; num_bits <= 32; ++num_bits) {
+      const uint32_t mask = get_mask(num_bits);
+      const uint32_t values[] = { 0, mask, next_random() & mask, next_random() & mask };
+      const uint32_t prefix = next_random() & get_mask(offset);
+      
+      BitWriter writer;
+      writer.Write(prefix, offset);
+      for(uint32_t value : values) {
+        writer.Write(value, num_bits);
+      }
+      writer.WriteBool(true);
+      writer.Flush();
+      CHECK(writer.GetData().size() == (offset + 4 * num_bits + 1 + 7) / 8);
+      
+      BitReader reader(writer.GetData().data(), writer.GetData().size());
+      uint32_t read = 0;
+      CHECK(reader.Read(read, offset) && read == prefix);
+      for(uint32_t value : values) {
+        CHECK(reader.Read(read, num_bits) && read == value);
+      }
+      bool flag = false;
+      CHECK(reader.ReadBool(flag) && flag);
+      CHECK(reader.GetNumBitsLeft() < 8);
+    }
+  }
+}
+
+// values right below and at every power of two, so every group count is
+// hit, and the extremes of both signs.
+static void test_var() {
+  for(uint32_t group_bits = 1; group_bits < 32; ++group_bits) {
+    std::vector<uint64_t> values;
+    values.push_back(0);
+    values.push_back(~0ull);
+    for(uint32_t bit = 1; bit < 64; ++bit) {
+      values.push_back((1ull << bit) - 1);
+      values.push_back(1ull << bit);
+    }
+    
+    BitWriter writer;
+    for(uint64_t value : values) {
+      writer.WriteVar(value, group_bits);
+      writer.WriteSignedVar((int64_t)value, group_bits);
+      writer.WriteSignedVar(-(int64_t)(value >> 1), group_bits);
+    }
+    writer.WriteSignedVar(INT64_MIN, group_bits);
+    writer.WriteSignedVar(INT64_MAX, group_bits);
+    writer.Flush();
+    
+    BitReader reader(writer.GetData().data(), writer.GetData().size());
+    for(uint64_t value : values) {
+      uint64_t read = 0;
+      int64_t read_signed = 0;
+      CHECK(reader.ReadVar(read, group_bits) && read == value);
+      CHECK(reader.ReadSignedVar(read_signed, group_bits) && read_signed == (int64_t)value);
+      CHECK(reader.ReadSignedVar(read_signed, group_bits) && read_signed == -(int64_t)(value >> 1));
+    }
+    int64_t read_signed = 0;
+    CHECK(reader.ReadSignedVar(read_signed, group_bits) && read_signed == INT64_MIN);
+    CHECK(reader.ReadSignedVar(read_signed, group_bits) && read_signed == INT64_MAX);
+    CHECK(reader.GetNumBitsLeft() < 8);
+  }
+}
+
+// a flush pads to the next byte, later writes start on a byte boundary.
+static void test_flush() {
+  BitWriter writer;
+  writer.Write(5, 3);
+  writer.Flush();
+  CHECK(writer.GetNumBits() == 8);
+  writer.Write(0xabcd, 16);
+  writer.Flush();
+  CHECK(writer.GetNumBits() == 24);
+  CHECK(writer.GetData().size() == 3);
+  CHECK(writer.GetData()[0] == 5 && writer.GetData()[1] == 0xcd && writer.GetData()[2] == 0xab);
+  writer.Clear();
+  CHECK(writer.GetNumBits() == 0 && writer.GetData().empty());
+}
+
+// reads past the end fail and leave the position alone, a variable length
+// value longer than 64 bits is malformed.
+static void test_truncated_bits() {
+  const uint8_t data[] = { 0xff, 0xff };
+  BitReader reader(data, sizeof(data));
+  uint32_t value = 0;
+  CHECK(!reader.Read(value, 17));
+  CHECK(reader.Read(value, 10) && value == 0x3ff);
+  CHECK(!reader.Read(value, 7));
+  CHECK(reader.Read(value, 6) && value == 0x3f);
+  CHECK(!reader.Read(value, 1));
+  bool flag = false;
+  CHECK(!reader.ReadBool(flag));
+  
+  // all groups have their continue bit set.
+  const std::vector<uint8_t> endless(64, 0xff);
+  BitReader var_reader(endless.data(), endless.size());
+  uint64_t var = 0;
+  CHECK(!var_reader.ReadVar(var, 7));
+  
+  BitWriter writer;
+  writer.WriteVar(~0ull, 3);
+  writer.Flush();
+  for(size_t size = 0; size < writer.GetData().size(); ++size) {
+    BitReader truncated(writer.GetData().data(), size);
+    CHECK(!truncated.ReadVar(var, 3));
+  }
+}
+
+static bool same_packet(const InputPacket& a, const InputPacket& b) {
+  if(a.m_newest_tick != b.m_newest_tick || a.m_count != b.m_count) {
+    return false;
+  }
+  for(uint32_t i = 0; i < a.m_count; ++i) {
+    if(a.m_inputs[i] != b.m_inputs[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// writes, reads back and compares the packet, then checks that every
+// shorter prefix of its data fails to read.
+static void check_packet(const InputPacket& packet) {
+  BitWriter writer;
+  CHECK(write_input_packet(packet, writer));
+  writer.Flush();
+  const std::vector<uint8_t>& data = writer.GetData();
+  
+  InputPacket read;
+  BitReader reader(data.data(), data.size());
+  CHECK(read_input_packet(reader, read) && same_packet(packet, read));
+  CHECK(reader.GetNumBitsLeft() < 8);
+  
+  for(size_t size = 0; size < data.size(); ++size) {
+    BitReader truncated(data.data(), size);
+    CHECK(!read_input_packet(truncated, read));
+  }
+}
+
+// fills the packet with runs of the given lengths, newest first.
+static void fill_runs(InputPacket& packet, tick_t newest_tick, const std::vector<uint32_t>& runs) {
+  packet.m_newest_tick = newest_tick;
+  packet.m_count = 0;
+  uint32_t buttons = 1;
+  for(uint32_t length : runs) {
+    for(uint32_t i = 0; i < length; ++i) {
+      packet.m_inputs[packet.m_count++] = Input(buttons);
+    }
+    buttons = (buttons + 7) % (1u << kInputButtonBits);
+  }
+}
+
+static void test_input_runs() {
+  InputPacket packet;
+  // a single input, a full window of one run and of runs of one.
+  fill_runs(packet, 0, std::vector<uint32_t>(1, 1));
+  check_packet(packet);
+  fill_runs(packet, 1000, std::vector<uint32_t>(1, kMaxInputWindow));
+  check_packet(packet);
+  fill_runs(packet, 1000, std::vector<uint32_t>(kMaxInputWindow, 1));
+  check_packet(packet);
+  
+  // run lengths around the group boundaries of the length field, at the
+  // newest and the oldest end of the window.
+  const uint32_t lengths[] = { 7, 8, 9, 63 };
+  for(uint32_t length : lengths) {
+    std::vector<uint32_t> runs(1, length);
+    runs.push_back(kMaxInputWindow - length);
+    fill_runs(packet, 5000, runs);
+    check_packet(packet);
+    std::swap(runs[0], runs[1]);
+    fill_runs(packet, 5000, runs);
+    check_packet(packet);
+  }
+  
+  // the window may reach back to tick 0, newest ticks around var groups.
+  fill_runs(packet, kMaxInputWindow - 1, std::vector<uint32_t>(2, kMaxInputWindow / 2));
+  check_packet(packet);
+  const tick_t ticks[] = { 127, 128, 16383, 16384, ~(tick_t)0 };
+  for(tick_t tick : ticks) {
+    fill_runs(packet, tick, std::vector<uint32_t>(3, 5));
+    check_packet(packet);
+  }
+  
+  // all buttons, every key down.
+  packet.m_newest_tick = 100;
+  packet.m_count = 1;
+  packet.m_inputs[0] = Input((1u << kInputButtonBits) - 1);
+  check_packet(packet);
+}
+
+static void test_invalid_packets() {
+  InputPacket packet;
+  BitWriter writer;
+  packet.m_newest_tick = 10;
+  packet.m_count = 0;
+  CHECK(!write_input_packet(packet, writer));
+  packet.m_count = kMaxInputWindow + 1;
+  CHECK(!write_input_packet(packet, writer));
+  // reaches before tick 0.
+  packet.m_count = 12;
+  CHECK(!write_input_packet(packet, writer));
+  packet.m_count = 1;
+  packet.m_inputs[0] = Input(1u << kInputButtonBits);
+  CHECK(!write_input_packet(packet, writer));
+  CHECK(writer.GetNumBits() == 0);
+  
+  // a run longer than the inputs left.
+  writer.WriteVar(100, 7);
+  writer.WriteVar(3, 3);
+  writer.Write(2, kInputButtonBits);
+  writer.WriteVar(4, 3);
+  writer.Flush();
+  BitReader reader(writer.GetData().data(), writer.GetData().size());
+  CHECK(!read_input_packet(reader, packet));
+  
+  // a count reaching before tick 0.
+  writer.Clear();
+  writer.WriteVar(2, 7);
+  writer.WriteVar(3, 3);
+  writer.Write(2, kInputButtonBits);
+  writer.WriteVar(3, 3);
+  writer.Flush();
+  BitReader before_zero(writer.GetData().data(), writer.GetData().size());
+  CHECK(!read_input_packet(before_zero, packet));
+}
+
+static void test_input_window() {
+  InputWindow window(8);
+  InputPacket packet;
+  CHECK(!window.GetPacket(packet));
+  
+  // grows from tick 0, then slides.
+  for(tick_t tick = 0; tick < 20; ++tick) {
+    window.Push(tick, Input((uint32_t)(tick % 3) << 1));
+    CHECK(window.GetCount() == (tick < 8 ? tick + 1 : 8));
+    CHECK(window.GetPacket(packet) && packet.m_newest_tick == tick);
+    for(uint32_t i = 0; i < packet.m_count; ++i) {
+      CHECK(packet.m_inputs[i] == Input((uint32_t)(packet.GetTick(i) % 3) << 1));
+    }
+    check_packet(packet);
+  }
+  
+  // a gap restarts it.
+  window.Push(30, Input(2));
+  CHECK(window.GetCount() == 1 && window.GetNewestTick() == 30);
+}
+
+int main(int argc, const char* argv[]) {
+  (void)argc;
+  (void)argv;
+  test_bit_widths();
+  test_var();
+  test_flush();
+  test_truncated_bits();
+  test_input_runs();
+  test_invalid_packets();
+  test_input_window();
+  return finish_test("bit stream");
+}
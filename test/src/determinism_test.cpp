@@ -0,0 +1,339 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "common/job_system.h"
+#include "common/movement.h"
+#include "common/world.h"
+
+// replays a recorded input stream, with late and early inputs, and checks
+// that every way of stepping a game ends on the same state hashes: inline,
+// sparse checkpoints, job system threads, batched lanes and every movement
+// kernel. the hashes are then compared with the ones recorded for this
+// number mode, so a build on another compiler, flags or cpu has to match too.
+//
+// usage: servsim_determinism_test [--record] <data dir>
+// --record writes the inputs if there are none yet, then the hashes of the
+// mode it is built in. run it once from each mode's build.
+
+#if SERVSIM_FIXED_POINT
+static const char* kModeName = "fixed";
+#else
+static const char* kModeName = "float";
+#endif
+
+static const uint32_t kNumEntities = 3000;
+static const uint32_t kNumSteps = 600;
+static const uint32_t kHashInterval = 25;
+
+// input of 'tick' sent before step 'step', possibly late or early.
+struct RecordedInput {
+  uint32_t m_step;
+  tick_t m_tick;
+  uint32_t m_buttons;
+};
+
+struct RecordedHash {
+  tick_t m_tick;
+  uint64_t m_hash;
+};
+
+static std::string get_inputs_path(const char* dir) {
+  return std::string(dir) + "/determinism_inputs.txt";
+}
+
+static std::string get_hashes_path(const char* dir) {
+  return std::string(dir) + "/determinism_hashes_" + kModeName + ".txt";
+}
+
+// one input per tick, a tenth of them arriving up to 20 ticks late and a
+// twentieth up to 4 ticks early, on top of the on-time one of that step.
+static void generate_inputs(std::vector<RecordedInput>& inputs) {
+  uint32_t seed = 20261017;
+  for(uint32_t step = 0; step < kNumSteps; ++step) {
+    seed = seed * 1664525u + 1013904223u;
+    RecordedInput input;
+    input.m_step = step;
+    input.m_tick = step;
+    input.m_buttons = (seed >> 8) % 32 << 1;
+    inputs.push_back(input);
+    
+    const uint32_t roll = (seed >> 16) % 20;
+    if(roll < 2 && step > 20) {
+      input.m_tick = step - 1 - (seed >> 4) % 20;
+      input.m_buttons = (seed >> 12) % 32 << 1;
+      inputs.push_back(input);
+    } else if(roll == 2) {
+      input.m_tick = step + 1 + (seed >> 4) % 4;
+      input.m_buttons = (seed >> 12) % 32 << 1;
+      inputs.push_back(input);
+    }
+  }
+}
+
+static bool write_inputs(const std::string& path, const std::vector<RecordedInput>& inputs) {
+  FILE* file = fopen(path.c_str(), "w");
+  if(!file) {
+    return false;
+  }
+  fprintf(file, "# step tick buttons\n");
+  for(const RecordedInput& input : inputs) {
+    fprintf(file, "%u %llu %u\n", input.m_step, (unsigned long long)input.m_tick, input.m_buttons);
+  }
+  fclose(file);
+  return true;
+}
+
+static bool read_inputs(const std::string& path, std::vector<RecordedInput>& inputs) {
+  FILE* file = fopen(path.c_str(), "r");
+  if(!file) {
+    return false;
+  }
+  char line[128];
+  while(fgets(line, sizeof(line), file)) {
+    unsigned long long tick = 0;
+    RecordedInput input;
+    if(line[0] != '#' && 3 == sscanf(line, "%u %llu %u", &input.m_step, &tick, &input.m_buttons)) {
+      input.m_tick = tick;
+      inputs.push_back(input);
+    }
+  }
+  fclose(file);
+  return !inputs.empty();
+}
+
+static bool write_hashes(const std::string& path, const std::vector<RecordedHash>& hashes) {
+  FILE* file = fopen(path.c_str(), "w");
+  if(!file) {
+    return false;
+  }
+  fprintf(file, "# tick hash, %s\n", kModeName);
+  for(const RecordedHash& hash : hashes) {
+    fprintf(file, "%llu %016llx\n", (unsigned long long)hash.m_tick, (unsigned long long)hash.m_hash);
+  }
+  fclose(file);
+  return true;
+}
+
+static bool read_hashes(const std::string& path, std::vector<RecordedHash>& hashes) {
+  FILE* file = fopen(path.c_str(), "r");
+  if(!file) {
+    return false;
+  }
+  char line[128];
+  while(fgets(line, sizeof(line), file)) {
+    unsigned long long tick = 0;
+    unsigned long long hash = 0;
+    if(line[0] != '#' && 2 == sscanf(line, "%llu %llx", &tick, &hash)) {
+      RecordedHash recorded = { tick, hash };
+      hashes.push_back(recorded);
+    }
+  }
+  fclose(file);
+  return !hashes.empty();
+}
+
+// a grid of entities with holes from despawned ones, three quarters controlled.
+static void build_world(World& world) {
+  std::vector<entity_t> spawned;
+  for(uint32_t i = 0; i < kNumEntities; ++i) {
+    Cube cube;
+    cube.m_translation = vec3((float)(i % 100) * 1.5f, 1.f, (float)(i / 100) * 1.5f);
+    cube.m_rotation = (float)i * 0.1f;
+    spawned.push_back(world.Spawn(cube, i % 4 != 0));
+  }
+  for(uint32_t i = 0; i < kNumEntities; i += 7) {
+    world.Despawn(spawned[i]);
+  }
+}
+
+struct RunConfig {
+  const char* m_name;
+  uint32_t m_checkpoint_interval;
+  uint32_t m_num_threads;  // 0 steps inline.
+  uint32_t m_num_games;    // above 1 steps them with Game::StepBatch.
+  uint32_t m_lanes;
+};
+
+static const RunConfig kRunConfigs[] = {
+  { "inline", 1, 0, 1, 1 },
+  { "checkpoint 7", 7, 0, 1, 1 },
+  { "2 threads", 1, 2, 1, 1 },
+  { "4 threads", 4, 4, 1, 1 },
+  { "batch 3x4 lanes", 1, 0, 3, 4 },
+  { "batch 5x16 lanes", 3, 0, 5, 16 },
+};
+
+// replays the inputs into every game of the config and returns the hashes
+// of the first game. false if the games of a batch diverge.
+static bool run(const RunConfig& config, const World& initial, const std::vector<RecordedInput>& inputs,
+                std::vector<RecordedHash>& hashes) {
+  JobSystem* jobs = config.m_num_threads > 0 ? new JobSystem(config.m_num_threads) : nullptr;
+  std::vector<Game*> games;
+  for(uint32_t g = 0; g < config.m_num_games; ++g) {
+    Game* game = new Game(config.m_checkpoint_interval);
+    game->Reset(0, initial);
+    game->SetJobSystem(jobs);
+    games.push_back(game);
+  }
+  
+  bool same = true;
+  size_t next_input = 0;
+  for(uint32_t step = 0; step < kNumSteps; ++step) {
+    for(; next_input < inputs.size() && inputs[next_input].m_step == step; ++next_input) {
+      for(Game* game : games) {
+        game->UpdateInput(inputs[next_input].m_tick, Input(inputs[next_input].m_buttons));
+      }
+    }
+    if(games.size() > 1) {
+      Game::StepBatch(games.data(), (uint32_t)games.size(), config.m_lanes);
+    } else {
+      games[0]->Step();
+    }
+    
+    const tick_t tick = games[0]->GetCurrentTick();
+    if(tick % kHashInterval == 0 || step + 1 == kNumSteps) {
+      RecordedHash recorded = { tick, 0 };
+      games[0]->GetStateHash(tick, recorded.m_hash);
+      hashes.push_back(recorded);
+      for(Game* game : games) {
+        uint64_t hash = 0;
+        same = same && game->GetStateHash(tick, hash) && hash == recorded.m_hash;
+      }
+    }
+  }
+  
+  for(Game* game : games) {
+    delete game;
+  }
+  delete jobs;
+  return same;
+}
+
+// moves the positions of the world with every supported kernel for the
+// recorded buttons and compares them with the scalar loop bit for bit.
+static bool check_kernels(const World& initial, const std::vector<RecordedInput>& inputs) {
+  const uint32_t count = initial.GetNumEntities();
+  std::vector<scalar_t> reference_x(count);
+  std::vector<scalar_t> reference_z(count);
+  for(uint32_t i = 0; i < count; ++i) {
+    const scalar3 position = initial.GetTranslation(i);
+    reference_x[i] = position.x;
+    reference_z[i] = position.z;
+  }
+  
+  bool same = true;
+  const MoveKernel kernels[] = { MoveKernel::kScalar, MoveKernel::kSse2, MoveKernel::kAvx2 };
+  std::vector<scalar_t> x;
+  std::vector<scalar_t> z;
+  std::vector<scalar_t> scalar_x;
+  std::vector<scalar_t> scalar_z;
+  for(MoveKernel kernel : kernels) {
+    if((uint32_t)kernel > (uint32_t)get_move_kernel()) {
+      continue;
+    }
+    x = reference_x;
+    z = reference_z;
+    for(const RecordedInput& input : inputs) {
+      move_entities(kernel, x.data(), z.data(), initial.GetInputMask(), input.m_buttons, count);
+    }
+    if(kernel == MoveKernel::kScalar) {
+      scalar_x = x;
+      scalar_z = z;
+      continue;
+    }
+    const bool kernel_same = 0 == memcmp(x.data(), scalar_x.data(), count * sizeof(scalar_t))
+      && 0 == memcmp(z.data(), scalar_z.data(), count * sizeof(scalar_t));
+    if(!kernel_same) {
+      printf("FAIL: %s kernel differs from scalar\n", get_move_kernel_name(kernel));
+    }
+    same = same && kernel_same;
+  }
+  return same;
+}
+
+static bool same_hashes(const std::vector<RecordedHash>& a, const std::vector<RecordedHash>& b, tick_t& first_diff) {
+  for(size_t i = 0; i < a.size() || i < b.size(); ++i) {
+    if(i >= a.size() || i >= b.size() || a[i].m_tick != b[i].m_tick || a[i].m_hash != b[i].m_hash) {
+      first_diff = i < a.size() ? a[i].m_tick : b[i].m_tick;
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, const char* argv[]) {
+  bool record = false;
+  const char* dir = nullptr;
+  for(int i = 1; i < argc; ++i) {
+    if(0 == strcmp(argv[i], "--record")) {
+      record = true;
+    } else {
+      dir = argv[i];
+    }
+  }
+  if(!dir) {
+    printf("usage: %s [--record] <data dir>\n", argv[0]);
+    return 1;
+  }
+  
+  std::vector<RecordedInput> inputs;
+  const std::string inputs_path = get_inputs_path(dir);
+  if(!read_inputs(inputs_path, inputs)) {
+    if(!record) {
+      printf("FAIL: no inputs in %s\n", inputs_path.c_str());
+      return 1;
+    }
+    generate_inputs(inputs);
+    if(!write_inputs(inputs_path, inputs)) {
+      printf("FAIL: cannot write %s\n", inputs_path.c_str());
+      return 1;
+    }
+    printf("recorded %u inputs to %s\n", (uint32_t)inputs.size(), inputs_path.c_str());
+  }
+  
+  World initial;
+  build_world(initial);
+  
+  bool passed = check_kernels(initial, inputs);
+  std::vector<RecordedHash> reference;
+  for(const RunConfig& config : kRunConfigs) {
+    std::vector<RecordedHash> hashes;
+    const bool batch_same = run(config, initial, inputs, hashes);
+    tick_t first_diff = 0;
+    if(!batch_same) {
+      printf("FAIL: %s, games of the batch diverged\n", config.m_name);
+      passed = false;
+    } else if(reference.empty()) {
+      reference = hashes;
+    } else if(!same_hashes(hashes, reference, first_diff)) {
+      printf("FAIL: %s differs from %s at tick %llu\n", config.m_name, kRunConfigs[0].m_name,
+             (unsigned long long)first_diff);
+      passed = false;
+    }
+  }
+  
+  const std::string hashes_path = get_hashes_path(dir);
+  if(record) {
+    if(!passed || !write_hashes(hashes_path, reference)) {
+      printf("FAIL: not recording %s\n", hashes_path.c_str());
+      return 1;
+    }
+    printf("recorded %u %s hashes to %s\n", (uint32_t)reference.size(), kModeName, hashes_path.c_str());
+    return 0;
+  }
+  
+  std::vector<RecordedHash> expected;
+  tick_t first_diff = 0;
+  if(!read_hashes(hashes_path, expected)) {
+    printf("FAIL: no hashes in %s\n", hashes_path.c_str());
+    passed = false;
+  } else if(!same_hashes(reference, expected, first_diff)) {
+    printf("FAIL: %s differs from the recorded hashes at tick %llu\n", kModeName, (unsigned long long)first_diff);
+    passed = false;
+  }
+  printf("%s: %u inputs, %u hashes, %s\n", kModeName, (uint32_t)inputs.size(), (uint32_t)reference.size(),
+         passed ? "passed" : "FAILED");
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,146 @@
+#include "common/prediction.h"
+#include "test_util.h"
+
+// a client predicting ahead of a server that spawns and despawns entities
+// it does not know of: the snapshot has to count as a miss, bring the
+// client to the server's entity set and, resimulated, match the server.
+
+static Input get_input(tick_t tick) {
+  return Input(2u << (tick / 3 % 4));
+}
+
+static void step_to(Game& game, tick_t tick) {
+  while(game.GetCurrentTick() < tick) {
+    game.UpdateInput(game.GetCurrentTick(), get_input(game.GetCurrentTick()));
+    game.Step();
+  }
+}
+
+static bool same_quantized(const World& a, const World& b, tick_t tick, const SnapshotConfig& config) {
+  Snapshot snapshot_a, snapshot_b;
+  quantize_world(a, tick, config, snapshot_a);
+  quantize_world(b, tick, config, snapshot_b);
+  if(snapshot_a.m_entities.size() != snapshot_b.m_entities.size()) {
+    return false;
+  }
+  for(size_t i = 0; i < snapshot_a.m_entities.size(); ++i) {
+    const SnapshotEntity& entity_a = snapshot_a.m_entities[i];
+    const SnapshotEntity& entity_b = snapshot_b.m_entities[i];
+    if(entity_a.m_entity != entity_b.m_entity) {
+      return false;
+    }
+    for(uint32_t f = 0; f < SnapshotEntity::kNumFields; ++f) {
+      if(entity_a.m_fields[f] != entity_b.m_fields[f]) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static void test_spawn_and_despawn() {
+  World initial;
+  entity_t entities[4];
+  for(uint32_t i = 0; i < 4; ++i) {
+    Cube cube;
+    cube.m_translation = vec3((float)i * 2.f, 1.f, 0.f);
+    entities[i] = initial.Spawn(cube, i % 2 == 0);
+  }
+  
+  // at tick 2 the server replaces one entity with another of the same id,
+  // spawns a new one and despawns one.
+  Game server;
+  server.Reset(0, initial);
+  step_to(server, 2);
+  World changed;
+  changed.CopyFrom(server.GetCurrentState());
+  changed.Despawn(entities[1]);
+  Cube cube;
+  cube.m_translation = vec3(5.f, 1.f, 5.f);
+  CHECK(changed.Spawn(cube, false) == entities[1]);
+  const entity_t spawned = changed.Spawn(cube, false);
+  changed.Despawn(entities[3]);
+  server.Reset(2, changed);
+  step_to(server, 4);
+  
+  // the client never saw the change and is ahead.
+  const SnapshotConfig config;
+  Game client;
+  client.Reset(0, initial);
+  step_to(client, 7);
+  ClientPrediction prediction(client, config);
+  
+  Snapshot snapshot;
+  quantize_world(server.GetCurrentState(), server.GetCurrentTick(), config, snapshot);
+  CHECK(prediction.ApplySnapshot(snapshot));
+  CHECK(prediction.GetStats().m_num_misses == 1);
+  CHECK(prediction.GetStats().m_last_resimulated == 3);
+  
+  // resimulated from the snapshot, the client ends up where the server does.
+  step_to(client, 8);
+  step_to(server, 8);
+  uint32_t index;
+  CHECK(!client.GetCurrentState().FindIndex(entities[3], index));
+  CHECK(client.GetCurrentState().FindIndex(spawned, index));
+  CHECK(client.GetCurrentState().GetNumEntities() == server.GetCurrentState().GetNumEntities());
+  CHECK(same_quantized(client.GetCurrentState(), server.GetCurrentState(), 8, config));
+  
+  // the next snapshot matches the prediction.
+  quantize_world(server.GetCurrentState(), server.GetCurrentTick(), config, snapshot);
+  CHECK(prediction.ApplySnapshot(snapshot));
+  CHECK(prediction.GetStats().m_num_misses == 1);
+}
+
+static void test_spawn_with_id() {
+  World world;
+  Cube cube;
+  CHECK(world.SpawnWithId(5, cube, false));
+  CHECK(!world.SpawnWithId(5, cube, false));
+  CHECK(!world.SpawnWithId(World::kInvalidEntity, cube, false));
+  uint32_t index;
+  CHECK(world.FindIndex(5, index) && world.GetEntity(index) == 5);
+  CHECK(world.GetNumEntities() == 1);
+  
+  // the skipped ids are handed out by later spawns, never 5 again.
+  bool seen[6] = {};
+  for(uint32_t i = 0; i < 5; ++i) {
+    const entity_t entity = world.Spawn(cube, false);
+    CHECK(entity < 5 && !seen[entity]);
+    seen[entity < 5 ? entity : 5] = true;
+  }
+  CHECK(world.Spawn(cube, false) == 6);
+}
+
+// a reset at a tick between checkpoints, then a later authoritative state:
+// ticks before it still rebuild from the reset state.
+static void test_reset_between_checkpoints() {
+  World initial;
+  for(uint32_t i = 0; i < 3; ++i) {
+    Cube cube;
+    cube.m_translation = vec3((float)i * 2.f, 1.f, 0.f);
+    initial.Spawn(cube, true);
+  }
+  Game game(4);
+  game.Reset(5, initial);
+  step_to(game, 10);
+  Game reference(1);
+  reference.Reset(5, initial);
+  step_to(reference, 10);
+  
+  World state, reference_state;
+  CHECK(reference.GetState(7, reference_state));
+  CHECK(game.SetState(7, reference_state));
+  for(tick_t tick = 5; tick <= 10; ++tick) {
+    CHECK(game.GetState(tick, state) && reference.GetState(tick, reference_state));
+    CHECK(state.GetHash() == reference_state.GetHash());
+  }
+}
+
+int main(int argc, const char* argv[]) {
+  (void)argc;
+  (void)argv;
+  test_spawn_and_despawn();
+  test_spawn_with_id();
+  test_reset_between_checkpoints();
+  return finish_test("prediction");
+}
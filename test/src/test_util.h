@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+
+// failure counting and random numbers shared by the tests and benchmarks.
+
+inline uint32_t& get_num_failures() {
+  static uint32_t s_num_failures = 0;
+  return s_num_failures;
+}
+
+// counts and reports a failed condition, the test goes on.
+#define CHECK(condition) \
+  do { \
+    if(!(condition)) { \
+      printf("FAIL: %s:%d: %s\n", __FILE__, __LINE__, #condition); \
+      get_num_failures() += 1; \
+    } \
+  } while(0)
+
+// prints the result of the test and returns its exit code.
+inline int finish_test(const char* name) {
+  printf("%s: %s\n", name, get_num_failures() == 0 ? "passed" : "FAILED");
+  return get_num_failures() == 0 ? 0 : 1;
+}
+
+// the same sequence every run, so failures reproduce.
+inline uint32_t next_random() {
+  static uint32_t s_seed = 12345;
+  s_seed = s_seed * 1664525u + 1013904223u;
+  return s_seed ^ (s_seed >> 16);
+}
+
+inline float random_float(float min, float max) {
+  return min + (max - min) * (float)(next_random() >> 8) / (float)(1u << 24);
+}